@@ -0,0 +1,79 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include <math.h>
+
+// Color channels are floats in the 0-255 range unless noted otherwise
+struct ColorF
+{
+	float r;
+	float g;
+	float b;
+	float a;
+};
+
+inline float Clamp(float value, float low, float high)
+{
+	return (value < low) ? low : (value > high) ? high : value;
+}
+
+// sRGB (0-255) to linear light (0-1)
+inline float SrgbToLinear(float channel)
+{
+	const float c = channel / 255.0f;
+	return (c <= 0.04045f) ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+// Linear light (0-1) to sRGB (0-255)
+inline float LinearToSrgb(float channel)
+{
+	const float c = Clamp(channel, 0.0f, 1.0f);
+	return 255.0f * ((c <= 0.0031308f) ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f);
+}
+
+// WCAG relative luminance (0-1)
+inline float RelativeLuminance(const ColorF& color)
+{
+	return 0.2126f * SrgbToLinear(color.r) + 0.7152f * SrgbToLinear(color.g) + 0.0722f * SrgbToLinear(color.b);
+}
+
+// WCAG contrast ratio (1-21)
+inline float ContrastRatio(const ColorF& color1, const ColorF& color2)
+{
+	const float l1 = RelativeLuminance(color1);
+	const float l2 = RelativeLuminance(color2);
+	return (l1 > l2) ? (l1 + 0.05f) / (l2 + 0.05f) : (l2 + 0.05f) / (l1 + 0.05f);
+}
+
+// Linear sRGB (0-1) to OKLab. See: https://bottosson.github.io/posts/oklab/
+inline void LinearToOklab(float r, float g, float b, float& L, float& A, float& B)
+{
+	const float l = cbrtf(0.4122214708f * r + 0.5363325363f * g + 0.0514459929f * b);
+	const float m = cbrtf(0.2119034982f * r + 0.6806995451f * g + 0.1073969566f * b);
+	const float s = cbrtf(0.0883024619f * r + 0.2817188376f * g + 0.6299787005f * b);
+
+	L = 0.2104542553f * l + 0.7936177850f * m - 0.0040720468f * s;
+	A = 1.9779984951f * l - 2.4285922050f * m + 0.4505937099f * s;
+	B = 0.0259040371f * l + 0.7827717662f * m - 0.8086757660f * s;
+}
+
+// OKLab to linear sRGB (0-1, can be out of range)
+inline void OklabToLinear(float L, float A, float B, float& r, float& g, float& b)
+{
+	float l = L + 0.3963377774f * A + 0.2158037573f * B;
+	float m = L - 0.1055613458f * A - 0.0638541728f * B;
+	float s = L - 0.0894841775f * A - 1.2914855480f * B;
+	l = l * l * l;
+	m = m * m * m;
+	s = s * s * s;
+
+	r = 4.0767416621f * l - 3.3077115913f * m + 0.2309699292f * s;
+	g = -1.2684380046f * l + 2.6097574011f * m - 0.3413193965f * s;
+	b = -0.0041960863f * l - 0.7034186147f * m + 1.7076147010f * s;
+}
@@ -0,0 +1,288 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "Derive.h"
+#include <algorithm>
+
+const DeriveExpression::Function DeriveExpression::c_Functions[] =
+{
+	{ L"mix", Op::MIX, "ccn" },				// mix(color1, color2, amount)
+	{ L"lighten", Op::LIGHTEN, "cn" },		// lighten(color, amount)
+	{ L"darken", Op::DARKEN, "cn" },		// darken(color, amount)
+	{ L"over", Op::OVER, "cc" },			// over(foreground, background)
+	{ L"contrast", Op::CONTRAST, "ccc" },	// contrast(background, color1, color2)
+	{ L"contrast", Op::CONTRAST_BW, "c" },	// contrast(background)
+	{ L"alpha", Op::ALPHA, "cn" },			// alpha(color, amount)
+	{ L"rgb", Op::RGB, "nnn" },				// rgb(red, green, blue)
+	{ L"rgba", Op::RGBA, "nnnn" }			// rgba(red, green, blue, alpha)
+};
+
+DeriveExpression::DeriveExpression() :
+	m_Code(),
+	m_Dependencies()
+{
+}
+
+void DeriveExpression::Clear()
+{
+	m_Code.clear();
+	m_Dependencies.clear();
+}
+
+bool DeriveExpression::Compile(LPCWSTR expression, std::wstring& error)
+{
+	Clear();
+
+	LPCWSTR pos = expression;
+	bool isColor = false;
+	int stack = 0;
+	if (!ParseExpression(pos, isColor, stack, error))
+	{
+		Clear();
+		return false;
+	}
+
+	while (iswspace(*pos)) ++pos;
+	if (*pos)
+	{
+		error = L"Unexpected \"";
+		error += pos;
+		error += L'"';
+		Clear();
+		return false;
+	}
+
+	if (!isColor)
+	{
+		error = L"Expression must result in a color";
+		Clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool DeriveExpression::ParseExpression(LPCWSTR& pos, bool& isColor, int& stack, std::wstring& error)
+{
+	while (iswspace(*pos)) ++pos;
+
+	LPCWSTR start = pos;
+	if (*pos == L'-' || *pos == L'+') ++pos;
+	while (iswalnum(*pos) || *pos == L'_' || *pos == L'.') ++pos;
+
+	std::wstring token(start, pos - start);
+	if (token.empty())
+	{
+		error = *pos ? L"Unexpected \"" + std::wstring(1, *pos) + L"\"" : L"Unexpected end of expression";
+		return false;
+	}
+
+	if (++stack > MAX_STACK)
+	{
+		error = L"Expression is too complex";
+		return false;
+	}
+
+	// Number
+	WCHAR* end = nullptr;
+	const float number = (float)wcstod(token.c_str(), &end);
+	if (end && *end == L'\0')
+	{
+		m_Code.push_back({ Op::NUMBER, -1, number });
+		isColor = false;
+		return true;
+	}
+
+	while (iswspace(*pos)) ++pos;
+
+	// ColorType
+	if (*pos != L'(')
+	{
+		ColorType type = ResolveColorType(GetColorTypeFromName(token.c_str()));
+		if (type == ColorType::INVALID || IsNumericColorType(type))
+		{
+			error = L"Unknown color \"" + token + L"\"";
+			return false;
+		}
+
+		if (std::find(m_Dependencies.begin(), m_Dependencies.end(), type) == m_Dependencies.end())
+		{
+			m_Dependencies.push_back(type);
+		}
+
+		m_Code.push_back({ Op::COLOR, GetColorTypeIndex(type), 0.0f });
+		isColor = true;
+		return true;
+	}
+
+	// Function: arguments are pushed left to right, the function replaces them with its result
+	--stack;
+	++pos;  // Skip (
+
+	std::string args;
+	for (;;)
+	{
+		while (iswspace(*pos)) ++pos;
+		if (*pos == L')' && args.empty()) break;
+
+		bool isArgColor = false;
+		if (!ParseExpression(pos, isArgColor, stack, error)) return false;
+		args += isArgColor ? 'c' : 'n';
+
+		while (iswspace(*pos)) ++pos;
+		if (*pos == L',')
+		{
+			++pos;
+			continue;
+		}
+		if (*pos == L')') break;
+
+		error = L"Expected \",\" or \")\" after argument of \"" + token + L"\"";
+		return false;
+	}
+	++pos;  // Skip )
+
+	const Function* function = nullptr;
+	bool isKnown = false;
+	for (const auto& f : c_Functions)
+	{
+		if (_wcsicmp(f.name, token.c_str()) != 0) continue;
+
+		isKnown = true;
+		if (args == f.args)
+		{
+			function = &f;
+			break;
+		}
+	}
+
+	if (!function)
+	{
+		error = isKnown ? L"Invalid arguments for \"" + token + L"\"" : L"Unknown function \"" + token + L"\"";
+		return false;
+	}
+
+	m_Code.push_back({ function->op, -1, 0.0f });
+	stack -= (int)args.size() - 1;
+	isColor = true;  // All functions return a color
+	return true;
+}
+
+UINT DeriveExpression::Refresh() const
+{
+	UINT generation = 0U;
+	for (ColorType type : m_Dependencies)
+	{
+		// Not in max(), which would evaluate (and retrieve) it twice
+		const UINT colorGeneration = RefreshColor(type).generation;
+		if (colorGeneration > generation) generation = colorGeneration;
+	}
+	return generation;
+}
+
+bool DeriveExpression::Evaluate(ColorF& result) const
+{
+	ColorF stack[MAX_STACK];
+	int top = -1;
+
+	auto mix = [](const ColorF& c1, const ColorF& c2, float t) -> ColorF
+	{
+		t = Clamp(t, 0.0f, 1.0f);
+		return { c1.r + (c2.r - c1.r) * t, c1.g + (c2.g - c1.g) * t, c1.b + (c2.b - c1.b) * t, c1.a + (c2.a - c1.a) * t };
+	};
+
+	for (const auto& instruction : m_Code)
+	{
+		switch (instruction.op)
+		{
+		case Op::COLOR:
+			{
+				const SnapshotEntry& entry = g_Snapshot.entries[instruction.index];
+				if (!entry.isValid) return false;
+
+				stack[++top] = UnpackColor(c_ColorTypes[instruction.index].type, entry.value);
+			}
+			break;
+
+		case Op::NUMBER:
+			stack[++top] = { instruction.number, instruction.number, instruction.number, instruction.number };
+			break;
+
+		case Op::MIX:
+			top -= 2;
+			stack[top] = mix(stack[top], stack[top + 1], stack[top + 2].r);
+			break;
+
+		case Op::LIGHTEN:
+			--top;
+			stack[top] = mix(stack[top], { 255.0f, 255.0f, 255.0f, stack[top].a }, stack[top + 1].r);
+			break;
+
+		case Op::DARKEN:
+			--top;
+			stack[top] = mix(stack[top], { 0.0f, 0.0f, 0.0f, stack[top].a }, stack[top + 1].r);
+			break;
+
+		case Op::OVER:
+			{
+				--top;
+				const ColorF& fg = stack[top];
+				const ColorF& bg = stack[top + 1];
+
+				const float fa = fg.a / 255.0f;
+				const float ba = (bg.a / 255.0f) * (1.0f - fa);
+				const float a = fa + ba;
+				if (a <= 0.0f)
+				{
+					stack[top] = { 0.0f, 0.0f, 0.0f, 0.0f };
+					break;
+				}
+
+				stack[top] = { (fg.r * fa + bg.r * ba) / a, (fg.g * fa + bg.g * ba) / a, (fg.b * fa + bg.b * ba) / a, a * 255.0f };
+			}
+			break;
+
+		case Op::CONTRAST:
+			top -= 2;
+			if (ContrastRatio(stack[top], stack[top + 2]) > ContrastRatio(stack[top], stack[top + 1]))
+			{
+				stack[top] = stack[top + 2];
+			}
+			else
+			{
+				stack[top] = stack[top + 1];
+			}
+			break;
+
+		case Op::CONTRAST_BW:
+			{
+				const ColorF black = { 0.0f, 0.0f, 0.0f, 255.0f };
+				const ColorF white = { 255.0f, 255.0f, 255.0f, 255.0f };
+				stack[top] = (ContrastRatio(stack[top], white) > ContrastRatio(stack[top], black)) ? white : black;
+			}
+			break;
+
+		case Op::ALPHA:
+			--top;
+			stack[top].a = Clamp(stack[top + 1].r, 0.0f, 1.0f) * 255.0f;
+			break;
+
+		case Op::RGB:
+			top -= 2;
+			stack[top] = { stack[top].r, stack[top + 1].r, stack[top + 2].r, 255.0f };
+			break;
+
+		case Op::RGBA:
+			top -= 3;
+			stack[top] = { stack[top].r, stack[top + 1].r, stack[top + 2].r, stack[top + 3].r };
+			break;
+		}
+	}
+
+	result = stack[0];
+	return true;
+}
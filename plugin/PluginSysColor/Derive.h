@@ -0,0 +1,70 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include "SysColor.h"
+#include "ColorMath.h"
+#include <vector>
+
+// Color expression over ColorTypes (eg. "mix(Accent, Window, 0.3)"). The expression is compiled
+// once into a small stack based program that is evaluated against the snapshot.
+class DeriveExpression
+{
+public:
+	DeriveExpression();
+
+	bool Compile(LPCWSTR expression, std::wstring& error);
+	void Clear();
+
+	bool IsEmpty() const { return m_Code.empty(); }
+
+	// Refreshes every ColorType used by the expression. Returns the newest snapshot generation
+	// among them, so the expression only needs to be evaluated again when the result changes.
+	UINT Refresh() const;
+
+	// Returns false if a ColorType used by the expression could not be retrieved
+	bool Evaluate(ColorF& result) const;
+
+private:
+	enum class Op : BYTE
+	{
+		COLOR,		// Push snapshot color
+		NUMBER,		// Push number
+		MIX,
+		LIGHTEN,
+		DARKEN,
+		OVER,
+		CONTRAST,
+		CONTRAST_BW,
+		ALPHA,
+		RGB,
+		RGBA
+	};
+
+	struct Instruction
+	{
+		Op op;
+		int index;		// Snapshot index for COLOR
+		float number;	// Value for NUMBER
+	};
+
+	struct Function
+	{
+		LPCWSTR name;
+		Op op;
+		const char* args;	// 'c' for color, 'n' for number
+	};
+
+	static const Function c_Functions[];
+	static const int MAX_STACK = 16;
+
+	bool ParseExpression(LPCWSTR& pos, bool& isColor, int& stack, std::wstring& error);
+
+	std::vector<Instruction> m_Code;
+	std::vector<ColorType> m_Dependencies;
+};
@@ -0,0 +1,802 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "Freedesktop.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__linux__)
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+constexpr size_t MAX_LINE = 512;
+
+constexpr uint32_t Rgb(uint32_t rgb)
+{
+	// 0xRRGGBB to opaque 0xAABBGGRR
+	return 0xFF000000U | ((rgb & 0xFFU) << 16) | (rgb & 0xFF00U) | ((rgb >> 16) & 0xFFU);
+}
+
+// Default Adwaita colors, in ThemeColor order
+const uint32_t c_LightColors[] =
+{
+	Rgb(0x3584E4), Rgb(0xFAFAFA), Rgb(0x323232), Rgb(0xFFFFFF), Rgb(0x323232), Rgb(0x3584E4), Rgb(0xFFFFFF),
+	Rgb(0xEBEBEB), Rgb(0x323232), Rgb(0x333333), Rgb(0xFFFFFF), Rgb(0x1C71D8), Rgb(0x929292), Rgb(0xEBEBEB),
+	Rgb(0x2E2E2E), Rgb(0xFAFAFA), Rgb(0x929292)
+};
+
+const uint32_t c_DarkColors[] =
+{
+	Rgb(0x3584E4), Rgb(0x242424), Rgb(0xFFFFFF), Rgb(0x1E1E1E), Rgb(0xFFFFFF), Rgb(0x3584E4), Rgb(0xFFFFFF),
+	Rgb(0x363636), Rgb(0xFFFFFF), Rgb(0x303030), Rgb(0xFFFFFF), Rgb(0x78AEED), Rgb(0x7A7A7A), Rgb(0x303030),
+	Rgb(0xFFFFFF), Rgb(0x242424), Rgb(0x919191)
+};
+
+// Related color used when a color is not set, in ThemeColor order (COUNT: none)
+const ThemeColor c_Fallbacks[] =
+{
+	ThemeColor::COUNT,			// ACCENT
+	ThemeColor::COUNT,			// WINDOW
+	ThemeColor::COUNT,			// WINDOW_TEXT
+	ThemeColor::WINDOW,			// VIEW
+	ThemeColor::WINDOW_TEXT,	// VIEW_TEXT
+	ThemeColor::ACCENT,			// SELECTION
+	ThemeColor::COUNT,			// SELECTION_TEXT
+	ThemeColor::WINDOW,			// BUTTON
+	ThemeColor::WINDOW_TEXT,	// BUTTON_TEXT
+	ThemeColor::COUNT,			// TOOLTIP
+	ThemeColor::COUNT,			// TOOLTIP_TEXT
+	ThemeColor::ACCENT,			// LINK
+	ThemeColor::COUNT,			// DISABLED_TEXT
+	ThemeColor::WINDOW,			// TITLEBAR
+	ThemeColor::WINDOW_TEXT,	// TITLEBAR_TEXT
+	ThemeColor::TITLEBAR,		// TITLEBAR_INACTIVE
+	ThemeColor::DISABLED_TEXT	// TITLEBAR_INACTIVE_TEXT
+};
+
+static_assert(sizeof(c_LightColors) / sizeof(uint32_t) == (size_t)ThemeColor::COUNT, "c_LightColors does not match ThemeColor");
+static_assert(sizeof(c_DarkColors) / sizeof(uint32_t) == (size_t)ThemeColor::COUNT, "c_DarkColors does not match ThemeColor");
+static_assert(sizeof(c_Fallbacks) / sizeof(ThemeColor) == (size_t)ThemeColor::COUNT, "c_Fallbacks does not match ThemeColor");
+
+struct NameMapping
+{
+	const char* name;
+	ThemeColor color;
+};
+
+// GTK 3 theme colors and libadwaita colors
+const NameMapping c_GtkColors[] =
+{
+	{ "accent_bg_color", ThemeColor::ACCENT },
+	{ "accent_fg_color", ThemeColor::SELECTION_TEXT },
+	{ "accent_color", ThemeColor::LINK },
+	{ "link_color", ThemeColor::LINK },
+	{ "window_bg_color", ThemeColor::WINDOW },
+	{ "window_fg_color", ThemeColor::WINDOW_TEXT },
+	{ "theme_bg_color", ThemeColor::WINDOW },
+	{ "theme_fg_color", ThemeColor::WINDOW_TEXT },
+	{ "view_bg_color", ThemeColor::VIEW },
+	{ "view_fg_color", ThemeColor::VIEW_TEXT },
+	{ "theme_base_color", ThemeColor::VIEW },
+	{ "theme_text_color", ThemeColor::VIEW_TEXT },
+	{ "theme_selected_bg_color", ThemeColor::SELECTION },
+	{ "theme_selected_fg_color", ThemeColor::SELECTION_TEXT },
+	{ "insensitive_fg_color", ThemeColor::DISABLED_TEXT },
+	{ "headerbar_bg_color", ThemeColor::TITLEBAR },
+	{ "headerbar_fg_color", ThemeColor::TITLEBAR_TEXT },
+	{ "headerbar_backdrop_color", ThemeColor::TITLEBAR_INACTIVE }
+};
+
+struct KeyMapping
+{
+	const char* section;
+	const char* key;
+	ThemeColor color;
+};
+
+const KeyMapping c_KdeColors[] =
+{
+	{ "[General]", "AccentColor", ThemeColor::ACCENT },
+	{ "[Colors:Window]", "BackgroundNormal", ThemeColor::WINDOW },
+	{ "[Colors:Window]", "ForegroundNormal", ThemeColor::WINDOW_TEXT },
+	{ "[Colors:Window]", "ForegroundInactive", ThemeColor::DISABLED_TEXT },
+	{ "[Colors:Window]", "ForegroundLink", ThemeColor::LINK },
+	{ "[Colors:View]", "BackgroundNormal", ThemeColor::VIEW },
+	{ "[Colors:View]", "ForegroundNormal", ThemeColor::VIEW_TEXT },
+	{ "[Colors:Selection]", "BackgroundNormal", ThemeColor::SELECTION },
+	{ "[Colors:Selection]", "ForegroundNormal", ThemeColor::SELECTION_TEXT },
+	{ "[Colors:Button]", "BackgroundNormal", ThemeColor::BUTTON },
+	{ "[Colors:Button]", "ForegroundNormal", ThemeColor::BUTTON_TEXT },
+	{ "[Colors:Tooltip]", "BackgroundNormal", ThemeColor::TOOLTIP },
+	{ "[Colors:Tooltip]", "ForegroundNormal", ThemeColor::TOOLTIP_TEXT },
+	{ "[Colors:Header]", "BackgroundNormal", ThemeColor::TITLEBAR },
+	{ "[Colors:Header]", "ForegroundNormal", ThemeColor::TITLEBAR_TEXT },
+	{ "[Colors:Header][Inactive]", "BackgroundNormal", ThemeColor::TITLEBAR_INACTIVE },
+	{ "[Colors:Header][Inactive]", "ForegroundNormal", ThemeColor::TITLEBAR_INACTIVE_TEXT },
+	{ "[WM]", "activeBackground", ThemeColor::TITLEBAR },
+	{ "[WM]", "activeForeground", ThemeColor::TITLEBAR_TEXT },
+	{ "[WM]", "inactiveBackground", ThemeColor::TITLEBAR_INACTIVE },
+	{ "[WM]", "inactiveForeground", ThemeColor::TITLEBAR_INACTIVE_TEXT }
+};
+
+// Reads the next line (without the line break) into |line|. Lines that do not fit are skipped.
+bool ReadLine(FILE* file, char (&line)[MAX_LINE])
+{
+	while (fgets(line, (int)MAX_LINE, file))
+	{
+		size_t length = strlen(line);
+		if (length > 0 && line[length - 1] == '\n')
+		{
+			line[--length] = '\0';
+			if (length > 0 && line[length - 1] == '\r') line[--length] = '\0';
+			return true;
+		}
+
+		if (feof(file)) return true;  // Last line without a line break
+
+		int c = 0;
+		while ((c = fgetc(file)) != EOF && c != '\n') { }
+	}
+
+	return false;
+}
+
+char* SkipSpaces(char* str)
+{
+	while (isspace((unsigned char)*str)) ++str;
+	return str;
+}
+
+char* Trim(char* str)
+{
+	str = SkipSpaces(str);
+
+	char* end = str + strlen(str);
+	while (end > str && isspace((unsigned char)end[-1])) --end;
+	*end = '\0';
+
+	return str;
+}
+
+// Splits "Key=Value" in place
+bool SplitKeyValue(char* str, char*& key, char*& value)
+{
+	char* equals = strchr(str, '=');
+	if (!equals) return false;
+
+	*equals = '\0';
+	key = Trim(str);
+	value = Trim(equals + 1);
+	return true;
+}
+
+bool ContainsNoCase(const char* str, const char* find)
+{
+	for (; *str; ++str)
+	{
+		size_t i = 0;
+		while (find[i] && tolower((unsigned char)str[i]) == tolower((unsigned char)find[i])) ++i;
+		if (!find[i]) return true;
+	}
+
+	return false;
+}
+
+bool IsTrue(const char* str)
+{
+	return strcmp(str, "1") == 0 || ContainsNoCase(str, "true");
+}
+
+int HexDigit(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+uint32_t Pack(int r, int g, int b, int a)
+{
+	return (uint32_t)r | ((uint32_t)g << 8) | ((uint32_t)b << 16) | ((uint32_t)a << 24);
+}
+
+// "#RGB", "#RGBA", "#RRGGBB" or "#RRGGBBAA"
+bool ParseHexColor(const char* str, uint32_t& color)
+{
+	int digits[8] = { 0 };
+	int count = 0;
+	for (; *str; ++str)
+	{
+		const int digit = HexDigit(*str);
+		if (digit < 0 || count == 8) return false;
+		digits[count++] = digit;
+	}
+
+	int c[4] = { 0, 0, 0, 255 };
+	if (count == 3 || count == 4)
+	{
+		for (int i = 0; i < count; ++i) c[i] = digits[i] * 17;
+	}
+	else if (count == 6 || count == 8)
+	{
+		for (int i = 0; i < count / 2; ++i) c[i] = digits[i * 2] * 16 + digits[i * 2 + 1];
+	}
+	else
+	{
+		return false;
+	}
+
+	color = Pack(c[0], c[1], c[2], c[3]);
+	return true;
+}
+
+// "R,G,B" or "R,G,B,A" up to |end|. Channels are from 0 to 255 or percentages. The alpha channel is
+// from 0 to 1 for CSS (rgba()) and from 0 to 255 for KDE.
+bool ParseChannels(const char* str, bool isCss, char end, uint32_t& color)
+{
+	int c[4] = { 0, 0, 0, 255 };
+	int count = 0;
+	while (count < 4)
+	{
+		char* next = nullptr;
+		double value = strtod(str, &next);
+		if (next == str) return false;
+
+		next = SkipSpaces(next);
+		if (*next == '%')
+		{
+			value = value * 255.0 / 100.0;
+			next = SkipSpaces(next + 1);
+		}
+		else if (isCss && count == 3)
+		{
+			value *= 255.0;
+		}
+
+		value = (value < 0.0) ? 0.0 : (value > 255.0) ? 255.0 : value;
+		c[count++] = (int)(value + 0.5);
+
+		if (*next != ',')
+		{
+			str = next;
+			break;
+		}
+		str = next + 1;
+	}
+
+	if (count < 3 || *str != end) return false;
+
+	color = Pack(c[0], c[1], c[2], c[3]);
+	return true;
+}
+
+bool ParseColor(const char* str, uint32_t& color)
+{
+	if (*str == '#') return ParseHexColor(str + 1, color);
+	if (strncmp(str, "rgba(", 5) == 0) return ParseChannels(str + 5, true, ')', color);
+	if (strncmp(str, "rgb(", 4) == 0) return ParseChannels(str + 4, true, ')', color);
+	if (isdigit((unsigned char)*str)) return ParseChannels(str, false, '\0', color);
+	return false;
+}
+
+ThemeColor FindGtkColor(const char* name)
+{
+	for (const auto& mapping : c_GtkColors)
+	{
+		if (strcmp(mapping.name, name) == 0) return mapping.color;
+	}
+
+	return ThemeColor::COUNT;
+}
+
+// Blanks out /* comments */ in place. |inComment| carries over to the next line.
+void StripComments(char* str, bool& inComment)
+{
+	for (char* p = str; *p; ++p)
+	{
+		if (inComment)
+		{
+			if (p[0] == '*' && p[1] == '/')
+			{
+				p[0] = p[1] = ' ';
+				++p;
+				inComment = false;
+			}
+			else
+			{
+				*p = ' ';
+			}
+		}
+		else if (p[0] == '/' && p[1] == '*')
+		{
+			p[0] = p[1] = ' ';
+			++p;
+			inComment = true;
+		}
+	}
+}
+
+FILE* OpenFile(const std::string& path)
+{
+	FILE* file = nullptr;
+
+#ifdef _WIN32
+	WCHAR widePath[MAX_PATH] = { 0 };
+	if (MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, widePath, _countof(widePath)) <= 0) return nullptr;
+	if (_wfopen_s(&file, widePath, L"rb") != 0) return nullptr;
+#else
+	file = fopen(path.c_str(), "rb");
+#endif
+
+	return file;
+}
+
+std::string GetEnvironment(const char* name)
+{
+	std::string result;
+
+#ifdef _WIN32
+	char* value = nullptr;
+	size_t length = 0;
+	if (_dupenv_s(&value, &length, name) == 0 && value)
+	{
+		result = value;
+		free(value);
+	}
+#else
+	const char* value = getenv(name);
+	if (value) result = value;
+#endif
+
+	return result;
+}
+
+// Theme directories, relative to the configuration directory
+const char* const c_Directories[] = { "", "gtk-3.0", "gtk-4.0" };
+
+std::string GetDirectory(const std::string& configDir, int index)
+{
+	return *c_Directories[index] ? configDir + '/' + c_Directories[index] : configDir;
+}
+
+};  // namespace
+
+void FreedesktopTheme::Clear()
+{
+	memset(colors, 0, sizeof(colors));
+	validMask = 0U;
+	mode = ThemeMode::UNKNOWN;
+}
+
+void FreedesktopTheme::Set(ThemeColor color, uint32_t value)
+{
+	colors[(int)color] = value;
+	validMask |= 1U << (int)color;
+}
+
+uint32_t FreedesktopTheme::Get(ThemeColor color) const
+{
+	for (ThemeColor c = color; c != ThemeColor::COUNT; c = c_Fallbacks[(int)c])
+	{
+		if (IsSet(c)) return colors[(int)c];
+	}
+
+	return (mode == ThemeMode::DARK) ? c_DarkColors[(int)color] : c_LightColors[(int)color];
+}
+
+void ParseGtkSettings(FILE* file, FreedesktopTheme& theme)
+{
+	char line[MAX_LINE];
+	bool inSettings = false;
+	int preferDark = -1;
+	int darkTheme = -1;
+
+	while (ReadLine(file, line))
+	{
+		char* str = Trim(line);
+		if (*str == '[')
+		{
+			inSettings = strcmp(str, "[Settings]") == 0;
+			continue;
+		}
+
+		char* key = nullptr;
+		char* value = nullptr;
+		if (!inSettings || *str == '#' || *str == ';' || !SplitKeyValue(str, key, value)) continue;
+
+		if (strcmp(key, "gtk-application-prefer-dark-theme") == 0)
+		{
+			preferDark = IsTrue(value) ? 1 : 0;
+		}
+		else if (strcmp(key, "gtk-theme-name") == 0)
+		{
+			// eg. "Adwaita-dark" or "Adwaita:dark"
+			darkTheme = (ContainsNoCase(value, "-dark") || ContainsNoCase(value, ":dark")) ? 1 : 0;
+		}
+	}
+
+	if (preferDark == 1 || darkTheme == 1)
+	{
+		theme.mode = ThemeMode::DARK;
+	}
+	else if (preferDark == 0 || darkTheme == 0)
+	{
+		theme.mode = ThemeMode::LIGHT;
+	}
+}
+
+void ParseGtkCss(FILE* file, FreedesktopTheme& theme)
+{
+	char line[MAX_LINE];
+	bool inComment = false;
+
+	while (ReadLine(file, line))
+	{
+		StripComments(line, inComment);
+
+		// @define-color name value;
+		char* str = Trim(line);
+		if (strncmp(str, "@define-color", 13) != 0 || !isspace((unsigned char)str[13])) continue;
+
+		char* name = SkipSpaces(str + 13);
+		char* value = name;
+		while (*value && !isspace((unsigned char)*value)) ++value;
+		if (!*value) continue;
+		*value = '\0';
+
+		char* end = strchr(++value, ';');
+		if (!end) continue;
+		*end = '\0';
+		value = Trim(value);
+
+		const ThemeColor color = FindGtkColor(name);
+		if (color == ThemeColor::COUNT) continue;
+
+		uint32_t rgba = 0U;
+		if (*value == '@')
+		{
+			// Only references to colors that are mapped themselves are resolved
+			const ThemeColor reference = FindGtkColor(value + 1);
+			if (reference != ThemeColor::COUNT && theme.IsSet(reference))
+			{
+				theme.Set(color, theme.colors[(int)reference]);
+			}
+		}
+		else if (ParseColor(value, rgba))
+		{
+			theme.Set(color, rgba);
+		}
+	}
+}
+
+void ParseKdeGlobals(FILE* file, FreedesktopTheme& theme)
+{
+	char line[MAX_LINE];
+	char section[64] = { 0 };
+	uint32_t focus = 0U;
+	bool hasFocus = false;
+	bool hasAccent = false;
+
+	while (ReadLine(file, line))
+	{
+		char* str = Trim(line);
+		if (*str == '[')
+		{
+			// Sections can be nested, eg. "[Colors:Header][Inactive]"
+			snprintf(section, sizeof(section), "%s", str);
+			continue;
+		}
+
+		char* key = nullptr;
+		char* value = nullptr;
+		if (*str == '#' || !SplitKeyValue(str, key, value)) continue;
+
+		// Drop flags, eg. "Key[$e]"
+		char* flags = strchr(key, '[');
+		if (flags) *flags = '\0';
+
+		if (strcmp(section, "[General]") == 0 && strcmp(key, "ColorScheme") == 0)
+		{
+			theme.mode = ContainsNoCase(value, "dark") ? ThemeMode::DARK : ThemeMode::LIGHT;
+			continue;
+		}
+
+		// The focus decoration is the accent of color schemes without AccentColor
+		uint32_t rgba = 0U;
+		if (strcmp(section, "[Colors:View]") == 0 && strcmp(key, "DecorationFocus") == 0)
+		{
+			hasFocus = ParseColor(value, focus);
+			continue;
+		}
+
+		for (const auto& mapping : c_KdeColors)
+		{
+			if (strcmp(mapping.section, section) != 0 || strcmp(mapping.key, key) != 0) continue;
+
+			if (ParseColor(value, rgba))
+			{
+				theme.Set(mapping.color, rgba);
+				if (mapping.color == ThemeColor::ACCENT) hasAccent = true;
+			}
+			break;
+		}
+	}
+
+	if (!hasAccent && hasFocus)
+	{
+		theme.Set(ThemeColor::ACCENT, focus);
+	}
+}
+
+std::string GetFreedesktopConfigDir()
+{
+	std::string dir = GetEnvironment("XDG_CONFIG_HOME");
+	if (dir.empty())
+	{
+		dir = GetEnvironment("HOME");
+		if (dir.empty()) return dir;
+		dir += "/.config";
+	}
+
+#ifdef _WIN32
+	// Under Wine, the Unix file system is drive Z:
+	if (dir[0] == '/') dir.insert(0, "Z:");
+#endif
+
+	return dir;
+}
+
+int LoadFreedesktopTheme(const std::string& configDir, FreedesktopTheme& theme)
+{
+	static const struct
+	{
+		const char* path;
+		void (*parse)(FILE*, FreedesktopTheme&);
+	} c_Files[] =
+	{
+		{ "/gtk-3.0/settings.ini", ParseGtkSettings },
+		{ "/gtk-4.0/settings.ini", ParseGtkSettings },
+		{ "/kdeglobals", ParseKdeGlobals },
+		{ "/gtk-3.0/gtk.css", ParseGtkCss },
+		{ "/gtk-4.0/gtk.css", ParseGtkCss }
+	};
+
+	theme.Clear();
+
+	int count = 0;
+	for (const auto& f : c_Files)
+	{
+		FILE* file = OpenFile(configDir + f.path);
+		if (!file) continue;
+
+		f.parse(file, theme);
+		fclose(file);
+		++count;
+	}
+
+	// Themes that only set colors: guess the mode from the window background
+	if (theme.mode == ThemeMode::UNKNOWN && theme.IsSet(ThemeColor::WINDOW))
+	{
+		const uint32_t window = theme.colors[(int)ThemeColor::WINDOW];
+		const uint32_t sum = (window & 0xFFU) + ((window >> 8) & 0xFFU) + ((window >> 16) & 0xFFU);
+		theme.mode = (sum < 3U * 128U) ? ThemeMode::DARK : ThemeMode::LIGHT;
+	}
+
+	return count;
+}
+
+#if defined(__linux__)
+
+namespace
+{
+
+bool IsThemeFile(const char* name)
+{
+	return strcmp(name, "settings.ini") == 0 || strcmp(name, "gtk.css") == 0 || strcmp(name, "kdeglobals") == 0;
+}
+
+};  // namespace
+
+ThemeWatcher::ThemeWatcher() :
+	m_ConfigDir(),
+	m_Fd(-1),
+	m_Watches()
+{
+	for (int& watch : m_Watches) watch = -1;
+}
+
+ThemeWatcher::~ThemeWatcher()
+{
+	Stop();
+}
+
+bool ThemeWatcher::Start(const std::string& configDir)
+{
+	Stop();
+
+	m_ConfigDir = configDir;
+	m_Fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_Fd < 0) return false;
+
+	// The GTK directories are watched once they are created
+	if (!AddWatch(0))
+	{
+		Stop();
+		return false;
+	}
+
+	for (int i = 1; i < MAX_DIRECTORIES; ++i)
+	{
+		AddWatch(i);
+	}
+	return true;
+}
+
+bool ThemeWatcher::AddWatch(int index)
+{
+	// Files are usually replaced (moved over) instead of written, so the directories are watched
+	const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_CREATE | IN_DELETE | IN_ONLYDIR;
+	m_Watches[index] = inotify_add_watch(m_Fd, GetDirectory(m_ConfigDir, index).c_str(), mask);
+	return m_Watches[index] >= 0;
+}
+
+void ThemeWatcher::Stop()
+{
+	if (m_Fd >= 0)
+	{
+		close(m_Fd);  // Also removes the watches
+		m_Fd = -1;
+	}
+
+	for (int& watch : m_Watches) watch = -1;
+}
+
+bool ThemeWatcher::HasChanged()
+{
+	if (m_Fd < 0) return false;
+
+	bool changed = false;
+	alignas(inotify_event) char buffer[4096];
+	ssize_t size = 0;
+	while ((size = read(m_Fd, buffer, sizeof(buffer))) > 0)
+	{
+		const inotify_event* event = nullptr;
+		for (const char* p = buffer; p < buffer + size; p += sizeof(inotify_event) + event->len)
+		{
+			event = (const inotify_event*)p;
+
+			if (event->mask & IN_Q_OVERFLOW)
+			{
+				changed = true;
+			}
+			else if (event->mask & IN_IGNORED)
+			{
+				// Watched directory was deleted
+				for (int& watch : m_Watches)
+				{
+					if (watch == event->wd) watch = -1;
+				}
+				changed = true;
+			}
+			else if (event->len > 0 && (event->mask & IN_ISDIR) && event->wd == m_Watches[0])
+			{
+				for (int i = 1; i < MAX_DIRECTORIES; ++i)
+				{
+					if (m_Watches[i] < 0 && strcmp(event->name, c_Directories[i]) == 0)
+					{
+						AddWatch(i);
+						changed = true;
+					}
+				}
+			}
+			else if (event->len > 0 && IsThemeFile(event->name))
+			{
+				changed = true;
+			}
+		}
+	}
+
+	return changed;
+}
+
+#elif defined(_WIN32)
+
+ThemeWatcher::ThemeWatcher() :
+	m_ConfigDir(),
+	m_Handles()
+{
+	for (HANDLE& handle : m_Handles) handle = INVALID_HANDLE_VALUE;
+}
+
+ThemeWatcher::~ThemeWatcher()
+{
+	Stop();
+}
+
+bool ThemeWatcher::Start(const std::string& configDir)
+{
+	Stop();
+
+	m_ConfigDir = configDir;
+
+	// The GTK directories are watched once they are created
+	if (!AddWatch(0)) return false;
+
+	for (int i = 1; i < MAX_DIRECTORIES; ++i)
+	{
+		AddWatch(i);
+	}
+	return true;
+}
+
+bool ThemeWatcher::AddWatch(int index)
+{
+	WCHAR path[MAX_PATH] = { 0 };
+	if (MultiByteToWideChar(CP_UTF8, 0, GetDirectory(m_ConfigDir, index).c_str(), -1, path, _countof(path)) <= 0) return false;
+
+	// Directory names are watched to see the GTK directories being created
+	const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE;
+	m_Handles[index] = FindFirstChangeNotification(path, FALSE, filter);
+	return m_Handles[index] != INVALID_HANDLE_VALUE;
+}
+
+void ThemeWatcher::Stop()
+{
+	for (HANDLE& handle : m_Handles)
+	{
+		if (handle != INVALID_HANDLE_VALUE)
+		{
+			FindCloseChangeNotification(handle);
+			handle = INVALID_HANDLE_VALUE;
+		}
+	}
+}
+
+bool ThemeWatcher::HasChanged()
+{
+	bool changed = false;
+	for (int i = 0; i < MAX_DIRECTORIES; ++i)
+	{
+		HANDLE handle = m_Handles[i];
+		if (handle == INVALID_HANDLE_VALUE || WaitForSingleObject(handle, 0UL) != WAIT_OBJECT_0) continue;
+
+		changed = true;
+		if (!FindNextChangeNotification(handle))
+		{
+			// eg. the directory was deleted. The handle would stay signaled, so it is closed and a GTK
+			// directory is watched again once the configuration directory signals.
+			FindCloseChangeNotification(handle);
+			m_Handles[i] = INVALID_HANDLE_VALUE;
+		}
+
+		// Something was created in the configuration directory, which may be a GTK directory
+		if (i == 0)
+		{
+			for (int j = 1; j < MAX_DIRECTORIES; ++j)
+			{
+				if (m_Handles[j] == INVALID_HANDLE_VALUE) AddWatch(j);
+			}
+		}
+	}
+
+	return changed;
+}
+
+#else
+
+ThemeWatcher::ThemeWatcher() { }
+ThemeWatcher::~ThemeWatcher() { }
+bool ThemeWatcher::Start(const std::string& configDir) { m_ConfigDir = configDir; return false; }
+void ThemeWatcher::Stop() { }
+bool ThemeWatcher::HasChanged() { return false; }
+
+#endif
@@ -0,0 +1,113 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+// Reads the colors of freedesktop desktops (GTK and KDE) from their configuration files. This file
+// only depends on the C/C++ runtime, so it can be built and tested on Linux on its own.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+#ifdef _WIN32
+#include <Windows.h>
+#endif
+
+enum class ThemeColor : int
+{
+	ACCENT = 0,
+	WINDOW,
+	WINDOW_TEXT,
+	VIEW,					// Background of text fields and lists
+	VIEW_TEXT,
+	SELECTION,
+	SELECTION_TEXT,
+	BUTTON,
+	BUTTON_TEXT,
+	TOOLTIP,
+	TOOLTIP_TEXT,
+	LINK,
+	DISABLED_TEXT,
+	TITLEBAR,
+	TITLEBAR_TEXT,
+	TITLEBAR_INACTIVE,
+	TITLEBAR_INACTIVE_TEXT,
+
+	COUNT
+};
+
+enum class ThemeMode : int
+{
+	UNKNOWN = 0,
+	LIGHT,
+	DARK
+};
+
+struct FreedesktopTheme
+{
+	uint32_t colors[(int)ThemeColor::COUNT];	// 0xAABBGGRR (same layout as COLORREF)
+	uint32_t validMask;							// Bit per ThemeColor set by the files
+	ThemeMode mode;
+
+	void Clear();
+	void Set(ThemeColor color, uint32_t value);
+	bool IsSet(ThemeColor color) const { return (validMask & (1U << (int)color)) != 0U; }
+
+	// Colors not set by the files fall back to a related color (eg. VIEW to WINDOW), then to the
+	// default Adwaita color of the light/dark mode.
+	uint32_t Get(ThemeColor color) const;
+};
+
+// Each parser reads the file line by line into a fixed buffer and only sets the colors it finds.
+// Lines that do not fit the buffer are skipped.
+void ParseGtkSettings(FILE* file, FreedesktopTheme& theme);		// gtk-3.0/settings.ini, gtk-4.0/settings.ini
+void ParseGtkCss(FILE* file, FreedesktopTheme& theme);			// @define-color in gtk-3.0/gtk.css, gtk-4.0/gtk.css
+void ParseKdeGlobals(FILE* file, FreedesktopTheme& theme);		// kdeglobals
+
+// $XDG_CONFIG_HOME, or $HOME/.config. UTF-8.
+std::string GetFreedesktopConfigDir();
+
+// Reads the GTK settings.ini files, kdeglobals and the GTK gtk.css files (in that order, later
+// files override earlier ones) from |configDir|. Returns the number of files read.
+int LoadFreedesktopTheme(const std::string& configDir, FreedesktopTheme& theme);
+
+// Watches the theme files of |configDir| for changes. Uses inotify on Linux and change
+// notifications on Windows (which Wine implements with inotify), so nothing is polled. Change
+// notifications do not report file names, so on Windows a change to any file directly in
+// |configDir| (not only kdeglobals) is reported as a change.
+class ThemeWatcher
+{
+public:
+	ThemeWatcher();
+	~ThemeWatcher();
+
+	ThemeWatcher(const ThemeWatcher&) = delete;
+	ThemeWatcher& operator=(const ThemeWatcher&) = delete;
+
+	bool Start(const std::string& configDir);
+	void Stop();
+
+	// True if a theme file was written, created, replaced or deleted since the last call. Never blocks.
+	bool HasChanged();
+
+private:
+	static constexpr int MAX_DIRECTORIES = 3;	// |configDir|, gtk-3.0 and gtk-4.0
+
+	// Watches directory |index| (see MAX_DIRECTORIES). The GTK directories are watched once they
+	// are created.
+	bool AddWatch(int index);
+
+	std::string m_ConfigDir;
+
+#if defined(__linux__)
+	int m_Fd;
+	int m_Watches[MAX_DIRECTORIES];
+#elif defined(_WIN32)
+	HANDLE m_Handles[MAX_DIRECTORIES];
+#endif
+};
@@ -0,0 +1,107 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "History.h"
+#include <stdio.h>
+
+namespace
+{
+
+static HistoryEntry g_History[HISTORY_SIZE];
+
+// Number of changes ever written. The entry is written before the count is published, so a reader
+// that loaded the count never sees a half written entry unless the writer wrapped around past it.
+static std::atomic<UINT> g_HistoryCount(0U);
+
+static_assert((HISTORY_SIZE & (HISTORY_SIZE - 1U)) == 0U, "HISTORY_SIZE must be a power of 2");
+
+};  // namespace
+
+void RecordHistory(ColorType type, const SnapshotEntry& oldEntry, bool isValid, COLORREF value, UINT generation)
+{
+	const UINT count = g_HistoryCount.load(std::memory_order_relaxed);
+
+	HistoryEntry& entry = g_History[count & (HISTORY_SIZE - 1U)];
+	entry.tick = GetTickCount64();
+	entry.generation = generation;
+	entry.type = type;
+	entry.oldValue = oldEntry.value;
+	entry.newValue = value;
+	entry.wasValid = oldEntry.isValid;
+	entry.isValid = isValid;
+
+	g_HistoryCount.store(count + 1U, std::memory_order_release);
+}
+
+UINT GetHistoryCount()
+{
+	return g_HistoryCount.load(std::memory_order_acquire);
+}
+
+bool GetHistoryEntry(UINT age, HistoryEntry& entry)
+{
+	const UINT count = g_HistoryCount.load(std::memory_order_acquire);
+	if (age >= count || age >= HISTORY_SIZE) return false;
+
+	entry = g_History[(count - 1U - age) & (HISTORY_SIZE - 1U)];
+	return true;
+}
+
+bool FindLastChange(ColorType type, HistoryEntry& entry)
+{
+	for (UINT age = 0U; GetHistoryEntry(age, entry); ++age)
+	{
+		if (type == ColorType::INVALID || entry.type == type)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+std::wstring FormatHistoryEntry(const HistoryEntry& entry)
+{
+	std::wstring str = GetColorTypeName(entry.type);
+	str += L": ";
+	str += FormatPackedValue(entry.type, entry.wasValid, entry.oldValue);
+	str += L" -> ";
+	str += FormatPackedValue(entry.type, entry.isValid, entry.newValue);
+	return str;
+}
+
+bool DumpHistory(LPCWSTR path)
+{
+	FILE* file = nullptr;
+	if (_wfopen_s(&file, path, L"w, ccs=UTF-8") != 0 || !file) return false;
+
+	// Ticks are converted to local time relative to "now"
+	const ULONGLONG now = GetTickCount64();
+	FILETIME ft = { 0 };
+	GetSystemTimeAsFileTime(&ft);
+	const ULONGLONG nowTime = ((ULONGLONG)ft.dwHighDateTime << 32) | ft.dwLowDateTime;
+
+	fwprintf(file, L"; SysColor history: %u change(s), showing up to %u\n", GetHistoryCount(), HISTORY_SIZE);
+
+	HistoryEntry entry;
+	for (UINT age = 0U; GetHistoryEntry(age, entry); ++age)
+	{
+		const ULONGLONG time = nowTime - ((now - entry.tick) * 10000ULL);  // 100ns intervals
+		ft.dwLowDateTime = (DWORD)(time & 0xFFFFFFFFULL);
+		ft.dwHighDateTime = (DWORD)(time >> 32);
+
+		SYSTEMTIME utc = { 0 }, local = { 0 };
+		FileTimeToSystemTime(&ft, &utc);
+		SystemTimeToTzSpecificLocalTime(nullptr, &utc, &local);
+
+		fwprintf(file, L"%04u-%02u-%02u %02u:%02u:%02u.%03u  #%u  %s\n",
+			local.wYear, local.wMonth, local.wDay, local.wHour, local.wMinute, local.wSecond, local.wMilliseconds,
+			entry.generation, FormatHistoryEntry(entry).c_str());
+	}
+
+	fclose(file);
+	return true;
+}
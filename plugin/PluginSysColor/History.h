@@ -0,0 +1,40 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include "SysColor.h"
+
+// Fixed size ring buffer of snapshot changes. Only written when a snapshot entry changes, so it
+// costs nothing while the colors stay the same. There is a single writer (the thread calling
+// Update), readers never block it.
+constexpr UINT HISTORY_SIZE = 128U;  // Must be a power of 2
+
+struct HistoryEntry
+{
+	ULONGLONG tick;			// GetTickCount64() at the time of the change
+	UINT generation;		// Snapshot generation created by the change
+	ColorType type;
+	COLORREF oldValue;
+	COLORREF newValue;
+	bool wasValid;
+	bool isValid;
+};
+
+void RecordHistory(ColorType type, const SnapshotEntry& oldEntry, bool isValid, COLORREF value, UINT generation);
+
+// Total number of changes recorded since the plugin was loaded (can be larger than HISTORY_SIZE)
+UINT GetHistoryCount();
+
+// |age| of 0 is the most recent change. Returns false if the entry is no longer (or not yet) available.
+bool GetHistoryEntry(UINT age, HistoryEntry& entry);
+
+// Most recent change of |type| (or of any ColorType when |type| is INVALID)
+bool FindLastChange(ColorType type, HistoryEntry& entry);
+
+std::wstring FormatHistoryEntry(const HistoryEntry& entry);
+bool DumpHistory(LPCWSTR path);
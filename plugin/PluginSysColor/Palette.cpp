@@ -0,0 +1,267 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "Palette.h"
+#include "ColorMath.h"
+#include <algorithm>
+#include <map>
+#include <stdio.h>
+
+namespace
+{
+
+struct NamedColor
+{
+	LPCWSTR name;
+	DWORD rgb;		// 0xRRGGBB
+};
+
+// See: https://www.w3.org/TR/css-color-4/#named-colors
+// Note: Duplicate colors (Cyan, Magenta and the "Grey" spellings) are left out
+const NamedColor c_CssColors[] =
+{
+	{ L"AliceBlue", 0xF0F8FF }, { L"AntiqueWhite", 0xFAEBD7 }, { L"Aqua", 0x00FFFF }, { L"Aquamarine", 0x7FFFD4 },
+	{ L"Azure", 0xF0FFFF }, { L"Beige", 0xF5F5DC }, { L"Bisque", 0xFFE4C4 }, { L"Black", 0x000000 },
+	{ L"BlanchedAlmond", 0xFFEBCD }, { L"Blue", 0x0000FF }, { L"BlueViolet", 0x8A2BE2 }, { L"Brown", 0xA52A2A },
+	{ L"BurlyWood", 0xDEB887 }, { L"CadetBlue", 0x5F9EA0 }, { L"Chartreuse", 0x7FFF00 }, { L"Chocolate", 0xD2691E },
+	{ L"Coral", 0xFF7F50 }, { L"CornflowerBlue", 0x6495ED }, { L"Cornsilk", 0xFFF8DC }, { L"Crimson", 0xDC143C },
+	{ L"DarkBlue", 0x00008B }, { L"DarkCyan", 0x008B8B }, { L"DarkGoldenRod", 0xB8860B }, { L"DarkGray", 0xA9A9A9 },
+	{ L"DarkGreen", 0x006400 }, { L"DarkKhaki", 0xBDB76B }, { L"DarkMagenta", 0x8B008B }, { L"DarkOliveGreen", 0x556B2F },
+	{ L"DarkOrange", 0xFF8C00 }, { L"DarkOrchid", 0x9932CC }, { L"DarkRed", 0x8B0000 }, { L"DarkSalmon", 0xE9967A },
+	{ L"DarkSeaGreen", 0x8FBC8F }, { L"DarkSlateBlue", 0x483D8B }, { L"DarkSlateGray", 0x2F4F4F }, { L"DarkTurquoise", 0x00CED1 },
+	{ L"DarkViolet", 0x9400D3 }, { L"DeepPink", 0xFF1493 }, { L"DeepSkyBlue", 0x00BFFF }, { L"DimGray", 0x696969 },
+	{ L"DodgerBlue", 0x1E90FF }, { L"FireBrick", 0xB22222 }, { L"FloralWhite", 0xFFFAF0 }, { L"ForestGreen", 0x228B22 },
+	{ L"Fuchsia", 0xFF00FF }, { L"Gainsboro", 0xDCDCDC }, { L"GhostWhite", 0xF8F8FF }, { L"Gold", 0xFFD700 },
+	{ L"GoldenRod", 0xDAA520 }, { L"Gray", 0x808080 }, { L"Green", 0x008000 }, { L"GreenYellow", 0xADFF2F },
+	{ L"HoneyDew", 0xF0FFF0 }, { L"HotPink", 0xFF69B4 }, { L"IndianRed", 0xCD5C5C }, { L"Indigo", 0x4B0082 },
+	{ L"Ivory", 0xFFFFF0 }, { L"Khaki", 0xF0E68C }, { L"Lavender", 0xE6E6FA }, { L"LavenderBlush", 0xFFF0F5 },
+	{ L"LawnGreen", 0x7CFC00 }, { L"LemonChiffon", 0xFFFACD }, { L"LightBlue", 0xADD8E6 }, { L"LightCoral", 0xF08080 },
+	{ L"LightCyan", 0xE0FFFF }, { L"LightGoldenRodYellow", 0xFAFAD2 }, { L"LightGray", 0xD3D3D3 }, { L"LightGreen", 0x90EE90 },
+	{ L"LightPink", 0xFFB6C1 }, { L"LightSalmon", 0xFFA07A }, { L"LightSeaGreen", 0x20B2AA }, { L"LightSkyBlue", 0x87CEFA },
+	{ L"LightSlateGray", 0x778899 }, { L"LightSteelBlue", 0xB0C4DE }, { L"LightYellow", 0xFFFFE0 }, { L"Lime", 0x00FF00 },
+	{ L"LimeGreen", 0x32CD32 }, { L"Linen", 0xFAF0E6 }, { L"Maroon", 0x800000 }, { L"MediumAquaMarine", 0x66CDAA },
+	{ L"MediumBlue", 0x0000CD }, { L"MediumOrchid", 0xBA55D3 }, { L"MediumPurple", 0x9370DB }, { L"MediumSeaGreen", 0x3CB371 },
+	{ L"MediumSlateBlue", 0x7B68EE }, { L"MediumSpringGreen", 0x00FA9A }, { L"MediumTurquoise", 0x48D1CC }, { L"MediumVioletRed", 0xC71585 },
+	{ L"MidnightBlue", 0x191970 }, { L"MintCream", 0xF5FFFA }, { L"MistyRose", 0xFFE4E1 }, { L"Moccasin", 0xFFE4B5 },
+	{ L"NavajoWhite", 0xFFDEAD }, { L"Navy", 0x000080 }, { L"OldLace", 0xFDF5E6 }, { L"Olive", 0x808000 },
+	{ L"OliveDrab", 0x6B8E23 }, { L"Orange", 0xFFA500 }, { L"OrangeRed", 0xFF4500 }, { L"Orchid", 0xDA70D6 },
+	{ L"PaleGoldenRod", 0xEEE8AA }, { L"PaleGreen", 0x98FB98 }, { L"PaleTurquoise", 0xAFEEEE }, { L"PaleVioletRed", 0xDB7093 },
+	{ L"PapayaWhip", 0xFFEFD5 }, { L"PeachPuff", 0xFFDAB9 }, { L"Peru", 0xCD853F }, { L"Pink", 0xFFC0CB },
+	{ L"Plum", 0xDDA0DD }, { L"PowderBlue", 0xB0E0E6 }, { L"Purple", 0x800080 }, { L"RebeccaPurple", 0x663399 },
+	{ L"Red", 0xFF0000 }, { L"RosyBrown", 0xBC8F8F }, { L"RoyalBlue", 0x4169E1 }, { L"SaddleBrown", 0x8B4513 },
+	{ L"Salmon", 0xFA8072 }, { L"SandyBrown", 0xF4A460 }, { L"SeaGreen", 0x2E8B57 }, { L"SeaShell", 0xFFF5EE },
+	{ L"Sienna", 0xA0522D }, { L"Silver", 0xC0C0C0 }, { L"SkyBlue", 0x87CEEB }, { L"SlateBlue", 0x6A5ACD },
+	{ L"SlateGray", 0x708090 }, { L"Snow", 0xFFFAFA }, { L"SpringGreen", 0x00FF7F }, { L"SteelBlue", 0x4682B4 },
+	{ L"Tan", 0xD2B48C }, { L"Teal", 0x008080 }, { L"Thistle", 0xD8BFD8 }, { L"Tomato", 0xFF6347 },
+	{ L"Turquoise", 0x40E0D0 }, { L"Violet", 0xEE82EE }, { L"Wheat", 0xF5DEB3 }, { L"White", 0xFFFFFF },
+	{ L"WhiteSmoke", 0xF5F5F5 }, { L"Yellow", 0xFFFF00 }, { L"YellowGreen", 0x9ACD32 }
+};
+
+void ToOklab(BYTE r, BYTE g, BYTE b, float point[3])
+{
+	LinearToOklab(SrgbToLinear(r), SrgbToLinear(g), SrgbToLinear(b), point[0], point[1], point[2]);
+}
+
+// Palettes currently in use, by path
+static std::map<std::wstring, std::weak_ptr<const Palette>> g_Palettes;
+
+};  // namespace
+
+void Palette::Add(LPCWSTR name, BYTE r, BYTE g, BYTE b)
+{
+	Entry entry;
+	entry.name = name;
+	ToOklab(r, g, b, entry.point);
+	m_Entries.push_back(std::move(entry));
+}
+
+void Palette::LoadDefault()
+{
+	m_Entries.clear();
+	m_Entries.reserve(_countof(c_CssColors));
+
+	for (const auto& color : c_CssColors)
+	{
+		Add(color.name, (BYTE)(color.rgb >> 16), (BYTE)(color.rgb >> 8), (BYTE)color.rgb);
+	}
+
+	Build(0, (int)m_Entries.size(), 0);
+}
+
+bool Palette::LoadFile(LPCWSTR path, std::wstring& error)
+{
+	m_Entries.clear();
+
+	FILE* file = nullptr;
+	if (_wfopen_s(&file, path, L"r, ccs=UTF-8") != 0 || !file)
+	{
+		error = L"Could not open palette \"";
+		error += path;
+		error += L'"';
+		return false;
+	}
+
+	WCHAR line[256];
+	int lineNumber = 0;
+	while (fgetws(line, _countof(line), file))
+	{
+		++lineNumber;
+
+		// Lines that do not fit |line| cannot be colors (eg. long Shape or Calc values in a
+		// [Variables] file), so the rest of the line is skipped
+		const size_t length = wcslen(line);
+		if (length > 0 && line[length - 1] != L'\n' && !feof(file))
+		{
+			wint_t c = 0;
+			while ((c = fgetwc(file)) != WEOF && c != L'\n') { }
+			continue;
+		}
+
+		WCHAR* name = line;
+		while (iswspace(*name)) ++name;
+		if (!*name || *name == L';' || *name == L'[') continue;
+
+		WCHAR* value = wcschr(name, L'=');
+		if (!value || value == name)
+		{
+			error = L"Invalid palette line " + std::to_wstring(lineNumber);
+			fclose(file);
+			return false;
+		}
+
+		// Trim the name
+		WCHAR* end = value;
+		while (end > name && iswspace(end[-1])) --end;
+		*end = L'\0';
+
+		++value;
+		while (iswspace(*value)) ++value;
+		if (*value == L'#') ++value;
+
+		int r = 0, g = 0, b = 0;
+		if (wcschr(value, L','))
+		{
+			if (swscanf_s(value, L"%d , %d , %d", &r, &g, &b) != 3) r = -1;
+		}
+		else
+		{
+			unsigned int rgb = 0U;
+			if (swscanf_s(value, L"%6x", &rgb) == 1 && wcsspn(value, L"0123456789abcdefABCDEF") >= 6)
+			{
+				r = (rgb >> 16) & 0xFF;
+				g = (rgb >> 8) & 0xFF;
+				b = rgb & 0xFF;
+			}
+			else
+			{
+				r = -1;
+			}
+		}
+
+		// Skip other values (eg. "FontName=Segoe UI" in a [Variables] include file)
+		if (r < 0 || r > 255 || g < 0 || g > 255 || b < 0 || b > 255) continue;
+
+		Add(name, (BYTE)r, (BYTE)g, (BYTE)b);
+	}
+
+	fclose(file);
+
+	if (m_Entries.empty())
+	{
+		error = L"Palette is empty";
+		return false;
+	}
+
+	Build(0, (int)m_Entries.size(), 0);
+	return true;
+}
+
+void Palette::Build(int begin, int end, int axis)
+{
+	if (end - begin <= 1) return;
+
+	const int mid = (begin + end) / 2;
+	std::nth_element(m_Entries.begin() + begin, m_Entries.begin() + mid, m_Entries.begin() + end,
+		[axis](const Entry& e1, const Entry& e2) { return e1.point[axis] < e2.point[axis]; });
+
+	const int next = (axis + 1) % 3;
+	Build(begin, mid, next);
+	Build(mid + 1, end, next);
+}
+
+void Palette::Search(const float point[3], int begin, int end, int axis, int& best, float& bestDistance) const
+{
+	if (begin >= end) return;
+
+	const int mid = (begin + end) / 2;
+	const Entry& entry = m_Entries[mid];
+
+	const float d0 = point[0] - entry.point[0];
+	const float d1 = point[1] - entry.point[1];
+	const float d2 = point[2] - entry.point[2];
+	const float distance = d0 * d0 + d1 * d1 + d2 * d2;
+	if (distance < bestDistance)
+	{
+		bestDistance = distance;
+		best = mid;
+	}
+
+	// Search the side |point| is on first, the other side only if it can hold a closer entry
+	const float split = point[axis] - entry.point[axis];
+	const int next = (axis + 1) % 3;
+	if (split < 0.0f)
+	{
+		Search(point, begin, mid, next, best, bestDistance);
+		if (split * split < bestDistance) Search(point, mid + 1, end, next, best, bestDistance);
+	}
+	else
+	{
+		Search(point, mid + 1, end, next, best, bestDistance);
+		if (split * split < bestDistance) Search(point, begin, mid, next, best, bestDistance);
+	}
+}
+
+LPCWSTR Palette::FindNearest(COLORREF color) const
+{
+	if (m_Entries.empty()) return L"";
+
+	float point[3];
+	ToOklab(GetRValue(color), GetGValue(color), GetBValue(color), point);
+
+	int best = 0;
+	float bestDistance = 1e30f;
+	Search(point, 0, (int)m_Entries.size(), 0, best, bestDistance);
+	return m_Entries[best].name.c_str();
+}
+
+std::shared_ptr<const Palette> GetPalette(const std::wstring& path, std::wstring& error)
+{
+	auto it = g_Palettes.find(path);
+	if (it != g_Palettes.end())
+	{
+		if (auto palette = it->second.lock()) return palette;
+	}
+
+	auto palette = std::make_shared<Palette>();
+	if (path.empty())
+	{
+		palette->LoadDefault();
+	}
+	else if (!palette->LoadFile(path.c_str(), error))
+	{
+		return nullptr;
+	}
+
+	// Forget palettes no longer used by any measure
+	for (auto cached = g_Palettes.begin(); cached != g_Palettes.end();)
+	{
+		cached = cached->second.expired() ? g_Palettes.erase(cached) : std::next(cached);
+	}
+
+	g_Palettes[path] = palette;
+	return palette;
+}
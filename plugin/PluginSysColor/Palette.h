@@ -0,0 +1,49 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include <Windows.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Set of named colors. The colors are stored as a k-d tree in OKLab space (built once when the
+// palette is loaded), so finding the perceptually nearest name does not scan the whole palette.
+class Palette
+{
+public:
+	// CSS named colors
+	void LoadDefault();
+
+	// One color per line: "Name=RRGGBB" or "Name=R,G,B". Empty lines, lines starting with ";",
+	// [Section] lines, lines whose value is not a color and lines longer than 255 characters are
+	// ignored.
+	bool LoadFile(LPCWSTR path, std::wstring& error);
+
+	// |color| in 0xAABBGGRR format (alpha is ignored)
+	LPCWSTR FindNearest(COLORREF color) const;
+
+	bool IsEmpty() const { return m_Entries.empty(); }
+
+private:
+	struct Entry
+	{
+		std::wstring name;
+		float point[3];		// L, a, b
+	};
+
+	void Add(LPCWSTR name, BYTE r, BYTE g, BYTE b);
+	void Build(int begin, int end, int axis);
+	void Search(const float point[3], int begin, int end, int axis, int& best, float& bestDistance) const;
+
+	// Tree is implicit: the node of [begin, end) is at (begin + end) / 2
+	std::vector<Entry> m_Entries;
+};
+
+// Palettes are shared between measures. |path| of "" returns the CSS named colors.
+std::shared_ptr<const Palette> GetPalette(const std::wstring& path, std::wstring& error);
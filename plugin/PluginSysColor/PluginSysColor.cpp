@@ -13,9 +13,16 @@
 #include <wininet.h>
 #include <string>
 #include <vector>
+#include <algorithm>
 #include "../RainmeterAPI/RainmeterAPI.h"
+#include "SysColor.h"
+#include "History.h"
+#include "Provider.h"
+#include "Derive.h"
+#include "Ramp.h"
+#include "Palette.h"
+#include "Transform.h"
 
-#define GetAValue(rgb)			(LOBYTE((rgb) >> 24))
 #define SYSCOLOR_VERSION		((2 * 1000000) + (0 * 1000) + 0)
 #define SYSCOLOR_VERSIONSTR		L"2.0.0"
 
@@ -26,88 +33,12 @@ static HMODULE g_DWMApi = nullptr;
 static HMODULE g_UxTheme = nullptr;
 static UINT g_Instances = 0U;
 
-typedef struct COLORIZATIONPARAMS
-{
-	COLORREF	colorizationColor;
-	COLORREF	colorizationAfterglow;
-	UINT		colorizationColorBalance;
-	UINT		colorizationAfterglowBalance;
-	UINT		colorizationBlurBalance;
-	UINT		colorizationGlassReflectionIntensity;
-	BOOL		colorizationOpaqueBlend;
-} DWMColorizationParameters;
-
 typedef HRESULT(WINAPI* FPDWMGETCOLORIZATIONPARAMETERS)(COLORIZATIONPARAMS* pColorParams);
 static FPDWMGETCOLORIZATIONPARAMETERS c_DwmGetColorizationParameters = nullptr;
 
-typedef struct IMMERSIVE_COLOR_PREFERENCE
-{
-	COLORREF color1;
-	COLORREF color2;
-} ImmersiveColorPreference;
-
 typedef HRESULT(WINAPI* FPGETUSERCOLORPREFERENCE)(IMMERSIVE_COLOR_PREFERENCE* pImmersivePreference, BOOL forceReload);
 static FPGETUSERCOLORPREFERENCE c_GetUserColorPreference = nullptr;
 
-enum class ColorType : int
-{
-	INVALID = -1,
-
-	// Values to use with GetSysColorBrush (WinUser.h)
-	// Values documented here: https://learn.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-getsyscolor
-	// Note: Most of these are supposedly not supported by Windows 10+, but they still work (for now)
-	//       even if the OS doesn't use them much anymore
-	SCROLLBAR = COLOR_SCROLLBAR,
-	DESKTOP = COLOR_DESKTOP,
-	ACTIVECAPTION = COLOR_ACTIVECAPTION,
-	INACTIVECAPTION = COLOR_INACTIVECAPTION,
-	MENU = COLOR_MENU,
-	WINDOW = COLOR_WINDOW,
-	WINDOWFRAME = COLOR_WINDOWFRAME,
-	MENUTEXT = COLOR_MENUTEXT,
-	WINDOWTEXT = COLOR_WINDOWTEXT,
-	CAPTIONTEXT = COLOR_CAPTIONTEXT,
-	ACTIVEBORDER = COLOR_ACTIVEBORDER,
-	INACTIVEBORDER = COLOR_INACTIVEBORDER,
-	APPWORKSPACE = COLOR_APPWORKSPACE,
-	HIGHLIGHT = COLOR_HIGHLIGHT,
-	HIGHLIGHTTEXT = COLOR_HIGHLIGHTTEXT,
-	BUTTONFACE = COLOR_BTNFACE,
-	BUTTONSHADOW = COLOR_BTNSHADOW,
-	GRAYTEXT = COLOR_GRAYTEXT,
-	BUTTONTEXT = COLOR_BTNTEXT,
-	INACTIVECAPTIONTEXT = COLOR_INACTIVECAPTIONTEXT,
-	BUTTONHIGHLIGHT = COLOR_BTNHIGHLIGHT,
-	DDARKSHADOW = COLOR_3DDKSHADOW,
-	DLIGHT = COLOR_3DLIGHT,
-	INFOTEXT = COLOR_INFOTEXT,
-	INFOBACKGROUND = COLOR_INFOBK,
-	HOTLIGHT = COLOR_HOTLIGHT,
-	GRADIENTACTIVECAPTION = COLOR_GRADIENTACTIVECAPTION,
-	GRADIENTINACTIVECAPTION = COLOR_GRADIENTINACTIVECAPTION,
-	MENUHIGHLIGHT = COLOR_MENUHILIGHT,
-	MENUBAR = COLOR_MENUBAR,
-
-	// Windows 7 color used for DWM glass composition
-	// See: https://learn.microsoft.com/en-us/windows/win32/api/dwmapi/nf-dwmapi-dwmgetcolorizationcolor
-	WIN7_AERO = 100,
-
-	// Windows 10/11 accent color
-	// Retrieved from uxtheme.dll:GetUserColorPreference
-	ACCENT = 200,
-
-	// Raw DWM values retrived from the undocumented function "DwmGetColorizationParameters"
-	// Note: |WIN8_WINDOW| simulates how Windows 8/8.1 calculates its window color
-	WIN8_WINDOW = 300,
-	DWM_COLORIZATION_COLOR,
-	DWM_AFTERGLOW_COLOR,
-	DWM_COLOR_BALANCE,
-	DWM_AFTERGLOW_BALANCE,
-	DWM_BLUR_BALANCE,
-	DWM_GLASS_REFLECTION_INTENSITY,
-	DWM_OPAQUE_BLEND
-};
-
 enum class DisplayType : UINT
 {
 	ALL = 0U,		// Returns the entire color (can be without alpha channel depending on ColorType)
@@ -115,25 +46,94 @@ enum class DisplayType : UINT
 	GREEN,			// Returns only the Green channel of the color
 	BLUE,			// Returns only the Blue channel of the color
 	ALPHA,			// Returns only the Alpha channel
-	RGB				// Returns tthe entire color without the Alpha channel
+	RGB,			// Returns tthe entire color without the Alpha channel
+	NAME			// Returns the name of the nearest color of the palette
 };
 
+// Plain measures (ColorType only) asking for the same output share a slot, so the output is
+// formatted once per change no matter how many measures use it.
+struct OutputSlot
+{
+	ColorType colorType;
+	DisplayType displayType;
+	bool isHex;
+	std::shared_ptr<const Palette> palette;
+	std::shared_ptr<SnapshotTransform> transform;
+
+	UINT refCount;
+	UINT generation;		// Generation of the snapshot entry |color| was formatted from
+	std::wstring color;
+};
+
+static std::vector<OutputSlot*> g_OutputSlots;
+
 struct Measure
 {
+	void* rm;
+	OutputSlot* slot;
 	std::wstring color;
+	std::wstring functionResult;	// Returned by section variable functions
 	bool isHex;
 
 	ColorType colorType;
 	DisplayType displayType;
+	std::shared_ptr<const Palette> palette;		// DisplayType=Name only
+	std::shared_ptr<SnapshotTransform> transform;
+
+	DeriveExpression derive;
+
+	DeriveExpression rampFrom;
+	DeriveExpression rampTo;
+	int rampSteps;
+	RampSpace rampSpace;
+
+	UINT colorGeneration;		// Snapshot generation |color| was built from (Derive and Ramp only)
 
 	Measure() :
+		rm(nullptr),
+		slot(nullptr),
 		color(),
+		functionResult(),
 		isHex(false),
 		colorType(ColorType::INVALID),
-		displayType(DisplayType::ALL)
+		displayType(DisplayType::ALL),
+		palette(),
+		transform(),
+		derive(),
+		rampFrom(),
+		rampTo(),
+		rampSteps(5),
+		rampSpace(RampSpace::SRGB),
+		colorGeneration(UINT_MAX)
 	{ }
 };
 
+OutputSlot* AcquireOutputSlot(ColorType colorType, DisplayType displayType, bool isHex, const std::shared_ptr<const Palette>& palette,
+	const std::shared_ptr<SnapshotTransform>& transform)
+{
+	for (OutputSlot* slot : g_OutputSlots)
+	{
+		if (slot->colorType == colorType && slot->displayType == displayType && slot->isHex == isHex &&
+			slot->palette == palette && slot->transform == transform)
+		{
+			++slot->refCount;
+			return slot;
+		}
+	}
+
+	OutputSlot* slot = new OutputSlot{ colorType, displayType, isHex, palette, transform, 1U, 0U, std::wstring() };
+	g_OutputSlots.push_back(slot);
+	return slot;
+}
+
+void ReleaseOutputSlot(OutputSlot* slot)
+{
+	if (!slot || --slot->refCount > 0U) return;
+
+	g_OutputSlots.erase(std::find(g_OutputSlots.begin(), g_OutputSlots.end(), slot));
+	delete slot;
+}
+
 std::wstring ColorToString(const int color, bool hex)
 {
 	WCHAR buffer[5] = { 0 };
@@ -150,6 +150,73 @@ std::wstring ColorToString(const int color, bool hex)
 	return buffer;
 }
 
+// Formats a packed color according to |displayType|. Returns false (and an empty string) if the
+// requested channel is not available.
+bool FormatColor(std::wstring& str, COLORREF value, DisplayType displayType, bool hex, const Palette* palette)
+{
+	int r = GetRValue(value);
+	int g = GetGValue(value);
+	int b = GetBValue(value);
+	int a = GetAValue(value);
+
+	switch (displayType)
+	{
+	case DisplayType::RED:
+		str = ColorToString(r, hex);
+		break;
+
+	case DisplayType::GREEN:
+		str = ColorToString(g, hex);
+		break;
+
+	case DisplayType::BLUE:
+		str = ColorToString(b, hex);
+		break;
+
+	case DisplayType::ALPHA:
+		if (a)
+		{
+			str = ColorToString(a, hex);
+			break;
+		}
+		str.clear();
+		return false;
+
+	case DisplayType::RGB:
+		str = ColorToString(r, hex);  // Red
+		if (!hex) str += L",";
+
+		str += ColorToString(g, hex);  // Green
+		if (!hex) str += L",";
+
+		str += ColorToString(b, hex);  // Blue
+		break;
+
+	case DisplayType::ALL:
+		str = ColorToString(r, hex);  // Red
+		if (!hex) str += L",";
+
+		str += ColorToString(g, hex);  // Green
+		if (!hex) str += L",";
+
+		str += ColorToString(b, hex);  // Blue
+
+		if (a > 0)
+		{
+			if (!hex) str += L",";
+			str += ColorToString(a, hex);  // Alpha
+		}
+		break;
+
+	case DisplayType::NAME:
+		str = palette ? palette->FindNearest(value) : L"";
+		return !str.empty();
+	}
+
+
+	return true;
+}
+
 COLORREF ToCOLORREF(DWORD argb)
 {
 	// Converts 0xAARRGGBB format to 0xAABBGGRR
@@ -181,6 +248,27 @@ std::wstring Widen(const char* str, int strLen = -1, int cp = CP_ACP)
 	return wideStr;
 }
 
+std::string Narrow(const WCHAR* str, int strLen = -1, int cp = CP_ACP)
+{
+	std::string narrowStr;
+
+	if (str && *str)
+	{
+		if (strLen == -1)
+		{
+			strLen = (int)wcslen(str);
+		}
+
+		int bufLen = WideCharToMultiByte(cp, 0, str, strLen, nullptr, 0, nullptr, nullptr);
+		if (bufLen > 0)
+		{
+			narrowStr.resize(bufLen);
+			WideCharToMultiByte(cp, 0, str, strLen, &narrowStr[0], bufLen, nullptr, nullptr);
+		}
+	}
+	return narrowStr;
+}
+
 void CheckVersion(void* rm)
 {
 	HINTERNET hRootHandle = InternetOpen(L"Rainmeter: SysColor.dll", INTERNET_OPEN_TYPE_PRECONFIG, nullptr, nullptr, 0);
@@ -230,11 +318,380 @@ void CheckVersion(void* rm)
 	InternetCloseHandle(hRootHandle);
 }
 
+// Calls the OS directly
+class LiveProvider : public ColorProvider
+{
+public:
+	HRESULT GetColorizationColor(DWORD* color, BOOL* opaque) override
+	{
+		return DwmGetColorizationColor(color, opaque);
+	}
+
+	HRESULT GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference) override
+	{
+		if (!g_UxTheme || !c_GetUserColorPreference) return E_FAIL;
+		return c_GetUserColorPreference(preference, FALSE);
+	}
+
+	HRESULT IsCompositionEnabled(BOOL* enabled) override
+	{
+		return DwmIsCompositionEnabled(enabled);
+	}
+
+	HRESULT GetColorizationParameters(COLORIZATIONPARAMS* params) override
+	{
+		if (!g_DWMApi || !c_DwmGetColorizationParameters) return E_FAIL;  // Just in case
+		return c_DwmGetColorizationParameters(params);
+	}
+
+	bool GetSysColor(int index, COLORREF* color) override
+	{
+		HBRUSH hBrush = GetSysColorBrush(index);
+		LOGBRUSH lb = { 0 };
+		if (GetObject(hBrush, sizeof(LOGBRUSH), (LPSTR)&lb) <= 0 || !hBrush)
+		{
+			if (hBrush) DeleteObject(hBrush);
+			return false;
+		}
+
+		*color = lb.lbColor;
+		DeleteObject(hBrush);
+		return true;
+	}
+};
+
+static LiveProvider g_LiveProvider;
+static ColorProvider* g_Provider = &g_LiveProvider;
+
+// Parameters of WIN8_WINDOW and the raw DWM ColorTypes
+bool RetrieveDwmParameters(DWMColorizationParameters& params)
+{
+	ColorProvider* provider = GetProvider();
+
+	BOOL isEnabled = FALSE;
+	HRESULT hr = provider->IsCompositionEnabled(&isEnabled);
+	if (FAILED(hr)) return false;
+
+	hr = provider->GetColorizationParameters(&params);
+	return SUCCEEDED(hr);
+}
+
+bool GetDwmValue(ColorType type, const DWMColorizationParameters& params, COLORREF& value)
+{
+	switch (type)
+	{
+	case ColorType::WIN8_WINDOW:
+		{
+			// COLORREF is stored in 0xAABBGGRR format, but the color is stored in 0xAARRGGBB format.
+			DWORD color = ToCOLORREF(params.colorizationColor);
+			int r = GetRValue(color);
+			int g = GetGValue(color);
+			int b = GetBValue(color);
+
+			double bal = 100.0 - params.colorizationColorBalance;
+
+			r = min((int)round(r + (217 - r) * bal / 100.0), 255);
+			g = min((int)round(g + (217 - g) * bal / 100.0), 255);
+			b = min((int)round(b + (217 - b) * bal / 100.0), 255);
+
+			value = RGBA(r, g, b, GetAValue(color));
+		}
+		break;
+
+	case ColorType::DWM_COLORIZATION_COLOR:
+		value = ToCOLORREF(params.colorizationColor);
+		break;
+
+	case ColorType::DWM_AFTERGLOW_COLOR:
+		value = ToCOLORREF(params.colorizationAfterglow);
+		break;
+
+	case ColorType::DWM_COLOR_BALANCE:
+		value = params.colorizationColorBalance;
+		break;
+
+	case ColorType::DWM_AFTERGLOW_BALANCE:
+		value = params.colorizationAfterglowBalance;
+		break;
+
+	case ColorType::DWM_BLUR_BALANCE:
+		value = params.colorizationBlurBalance;
+		break;
+
+	case ColorType::DWM_GLASS_REFLECTION_INTENSITY:
+		value = params.colorizationGlassReflectionIntensity;
+		break;
+
+	case ColorType::DWM_OPAQUE_BLEND:
+		value = (COLORREF)params.colorizationOpaqueBlend;
+		break;
+
+	default:
+		return false;
+	}
+	return true;
+}
+
+bool RetrieveColor(ColorType type, COLORREF& value)
+{
+	ColorProvider* provider = GetProvider();
+
+	if (type == ColorType::WIN7_AERO)
+	{
+		DWORD color = 0UL;
+		BOOL opaque = FALSE;
+
+		// Color stored in 0xAARRGGBB format
+		HRESULT hr = provider->GetColorizationColor(&color, &opaque);
+		if (FAILED(hr)) return false;
+
+		value = ToCOLORREF(color);
+		return true;
+	}
+
+	// Windows 10/11
+	if (type == ColorType::ACCENT)
+	{
+		IMMERSIVE_COLOR_PREFERENCE immersiveColorPreference = { 0 };
+		HRESULT hr = provider->GetUserColorPreference(&immersiveColorPreference);
+		if (FAILED(hr)) return false;
+
+		value = immersiveColorPreference.color2;
+		return true;
+	}
+
+	// Raw DWM values (and WIN8_WINDOW)
+	if (type >= ColorType::WIN8_WINDOW)
+	{
+		DWMColorizationParameters params = { 0 };
+		return RetrieveDwmParameters(params) && GetDwmValue(type, params, value);
+	}
+
+	// GetSysColorBrush
+	COLORREF color = 0UL;
+	if (!provider->GetSysColor((int)type, &color)) return false;
+
+	value = color & 0x00FFFFFF;  // No alpha
+	return true;
+}
+
+// Formats the ramp as gradient stops: "Color ; Offset | Color ; Offset | ..."
+void BuildRampString(Measure* measure)
+{
+	measure->color.clear();
+
+	ColorF from, to;
+	if (!measure->rampFrom.Evaluate(from) || !measure->rampTo.Evaluate(to)) return;
+
+	ColorF stops[MAX_RAMP_STEPS];
+	BuildRamp(from, to, measure->rampSteps, measure->rampSpace, stops);
+	if (measure->transform) measure->transform->Apply(stops, measure->rampSteps);
+
+	std::wstring stop;
+	WCHAR offset[16] = { 0 };
+	for (int i = 0; i < measure->rampSteps; ++i)
+	{
+		if (!FormatColor(stop, PackColor(stops[i]), measure->displayType, measure->isHex, measure->palette.get()))
+		{
+			measure->color.clear();
+			return;
+		}
+
+		_snwprintf_s(offset, _TRUNCATE, L" ; %.4g", (double)i / (measure->rampSteps - 1));
+
+		if (i > 0) measure->color += L" | ";
+		measure->color += stop;
+		measure->color += offset;
+	}
+}
+
 };  // namespace
 
+const ColorTypeInfo c_ColorTypes[COLORTYPE_COUNT] =
+{
+	{ L"SCROLLBAR", ColorType::SCROLLBAR },
+	{ L"DESKTOP", ColorType::DESKTOP },
+	{ L"ACTIVECAPTION", ColorType::ACTIVECAPTION },
+	{ L"INACTIVECAPTION", ColorType::INACTIVECAPTION },
+	{ L"MENU", ColorType::MENU },
+	{ L"WINDOW", ColorType::WINDOW },
+	{ L"WINDOWFRAME", ColorType::WINDOWFRAME },
+	{ L"MENUTEXT", ColorType::MENUTEXT },
+	{ L"WINDOWTEXT", ColorType::WINDOWTEXT },
+	{ L"CAPTIONTEXT", ColorType::CAPTIONTEXT },
+	{ L"ACTIVEBORDER", ColorType::ACTIVEBORDER },
+	{ L"INACTIVEBORDER", ColorType::INACTIVEBORDER },
+	{ L"APPWORKSPACE", ColorType::APPWORKSPACE },
+	{ L"HIGHLIGHT", ColorType::HIGHLIGHT },
+	{ L"HIGHLIGHTTEXT", ColorType::HIGHLIGHTTEXT },
+	{ L"BUTTONFACE", ColorType::BUTTONFACE },
+	{ L"BUTTONSHADOW", ColorType::BUTTONSHADOW },
+	{ L"GRAYTEXT", ColorType::GRAYTEXT },
+	{ L"BUTTONTEXT", ColorType::BUTTONTEXT },
+	{ L"INACTIVECAPTIONTEXT", ColorType::INACTIVECAPTIONTEXT },
+	{ L"BUTTONHIGHLIGHT", ColorType::BUTTONHIGHLIGHT },
+	{ L"3DDARKSHADOW", ColorType::DDARKSHADOW },
+	{ L"3DLIGHT", ColorType::DLIGHT },
+	{ L"TOOLTIPTEXT", ColorType::INFOTEXT },
+	{ L"TOOLTIPBACKGROUND", ColorType::INFOBACKGROUND },
+	{ L"HYPERLINK", ColorType::HOTLIGHT },
+	{ L"ACTIVECAPTIONGRADIENT", ColorType::GRADIENTACTIVECAPTION },
+	{ L"INACTIVECAPTIONGRADIENT", ColorType::GRADIENTINACTIVECAPTION },
+	{ L"MENUHIGHLIGHT", ColorType::MENUHIGHLIGHT },
+	{ L"MENUBAR", ColorType::MENUBAR },
+
+	// Windows 7
+	{ L"AERO", ColorType::WIN7_AERO },
+
+	// Windows 10/11
+	{ L"ACCENT", ColorType::ACCENT },
+
+	// Raw DWM values retrived from the undocumented function "DwmGetColorizationParameters"
+	{ L"WIN8", ColorType::WIN8_WINDOW },
+	{ L"DWM_COLOR", ColorType::DWM_COLORIZATION_COLOR },
+	{ L"DWM_AFTERGLOW_COLOR", ColorType::DWM_AFTERGLOW_COLOR },
+	{ L"DWM_COLOR_BALANCE", ColorType::DWM_COLOR_BALANCE },
+	{ L"DWM_AFTERGLOW_BALANCE", ColorType::DWM_AFTERGLOW_BALANCE },
+	{ L"DWM_BLUR_BALANCE", ColorType::DWM_BLUR_BALANCE },
+	{ L"DWM_GLASS_REFLECTION_INTENSITY", ColorType::DWM_GLASS_REFLECTION_INTENSITY },
+	{ L"DWM_OPAQUE_BLEND", ColorType::DWM_OPAQUE_BLEND }
+};
+
+Snapshot g_Snapshot;
+
+ColorProvider* GetProvider()
+{
+	return g_Provider;
+}
+
+void SetProvider(ColorProvider* provider)
+{
+	if (g_Provider != &g_LiveProvider)
+	{
+		delete g_Provider;
+	}
+
+	g_Provider = provider ? provider : &g_LiveProvider;
+}
+
+// Restores the live provider and reports what went wrong while recording or replaying
+void StopProvider(void* rm)
+{
+	if (const RecordingProvider* recording = dynamic_cast<RecordingProvider*>(g_Provider))
+	{
+		if (recording->HasFailed())
+		{
+			RmLog(rm, LOG_ERROR, L"SysColor: Could not write to the log, the recording is incomplete");
+		}
+	}
+	else if (const ReplayProvider* replay = dynamic_cast<ReplayProvider*>(g_Provider))
+	{
+		if (replay->GetMismatches() > 0U)
+		{
+			RmLogF(rm, LOG_WARNING, L"SysColor: %u replayed calls did not match the next record of the log", replay->GetMismatches());
+		}
+	}
+
+	SetProvider(nullptr);
+}
+
+int GetColorTypeIndex(ColorType type)
+{
+	const int value = (int)type;
+	if (value >= COLOR_SCROLLBAR && value <= COLOR_MENUBAR)
+	{
+		// There is no system color with a value of 25
+		if (value == 25) return -1;
+		return (value < 25) ? value : value - 1;
+	}
+
+	if (type == ColorType::WIN7_AERO) return 30;
+	if (type == ColorType::ACCENT) return 31;
+
+	if (type >= ColorType::WIN8_WINDOW && type <= ColorType::DWM_OPAQUE_BLEND)
+	{
+		return 32 + (value - (int)ColorType::WIN8_WINDOW);
+	}
+
+	return -1;
+}
+
+ColorType ResolveColorType(ColorType type)
+{
+	if (type == ColorType::ACCENT && !(c_GetUserColorPreference && IsWindows10OrGreater()))
+	{
+		return ColorType::WIN7_AERO;
+	}
+	return type;
+}
+
+ColorType GetColorTypeFromName(LPCWSTR name)
+{
+	for (const auto& info : c_ColorTypes)
+	{
+		if (_wcsicmp(info.name, name) == 0) return info.type;
+	}
+	return ColorType::INVALID;
+}
+
+LPCWSTR GetColorTypeName(ColorType type)
+{
+	const int index = GetColorTypeIndex(type);
+	return (index != -1) ? c_ColorTypes[index].name : L"INVALID";
+}
+
+// Stores a retrieved value in the snapshot. The generation only changes when the value changes.
+const SnapshotEntry& StoreColor(ColorType type, bool isValid, COLORREF value)
+{
+	SnapshotEntry& entry = g_Snapshot.entries[GetColorTypeIndex(type)];
+	if (!isValid) value = 0UL;
+
+	if (entry.generation == 0U || isValid != entry.isValid || value != entry.value)
+	{
+		const UINT generation = ++g_Snapshot.generation;
+
+		// The first retrieval of a ColorType is not a change
+		if (entry.generation != 0U)
+		{
+			RecordHistory(type, entry, isValid, value, generation);
+		}
+
+		entry.value = value;
+		entry.isValid = isValid;
+		entry.generation = generation;
+	}
+
+	return entry;
+}
+
+const SnapshotEntry& RefreshColor(ColorType type)
+{
+	COLORREF value = 0UL;
+	const bool isValid = RetrieveColor(type, value);
+	return StoreColor(type, isValid, value);
+}
+
+std::wstring FormatPackedValue(ColorType type, bool isValid, COLORREF value)
+{
+	if (!isValid) return L"-";
+	if (IsNumericColorType(type)) return std::to_wstring(value);
+
+	WCHAR buffer[20] = { 0 };
+	if (GetAValue(value) > 0)
+	{
+		_snwprintf_s(buffer, _TRUNCATE, L"%d,%d,%d,%d", GetRValue(value), GetGValue(value), GetBValue(value), GetAValue(value));
+	}
+	else
+	{
+		_snwprintf_s(buffer, _TRUNCATE, L"%d,%d,%d", GetRValue(value), GetGValue(value), GetBValue(value));
+	}
+	return buffer;
+}
+
 PLUGIN_EXPORT void Initialize(void** data, void* rm)
 {
 	Measure* measure = new Measure;
+	measure->rm = rm;
 	*data = measure;
 
 	if (g_Instances == 0U)
@@ -308,414 +765,409 @@ PLUGIN_EXPORT void Reload(void* data, void* rm, double* maxValue)
 		{
 			measure->displayType = DisplayType::RGB;
 		}
+		else if (_wcsicmp(L"NAME", displayType) == 0)
+		{
+			measure->displayType = DisplayType::NAME;
+		}
 		else if (oldDisplayType != measure->displayType)
 		{
 			RmLogF(rm, LOG_ERROR, L"Unknown DisplayType: %s", displayType);
 		}
 	}
 
+	measure->palette.reset();
+	if (measure->displayType == DisplayType::NAME)
 	{
-		ColorType oldColorType = measure->colorType;
-		measure->colorType = ColorType::INVALID;
+		std::wstring path = RmReadString(rm, L"Palette", L"");
+		if (!path.empty()) path = RmPathToAbsolute(rm, path.c_str());
 
-		LPCWSTR colorType = RmReadString(rm, L"ColorType", L"ACCENT");
-		if (_wcsicmp(L"SCROLLBAR", colorType) == 0)
-		{
-			measure->colorType = ColorType::SCROLLBAR;
-		}
-		else if (_wcsicmp(L"DESKTOP", colorType) == 0)
-		{
-			measure->colorType = ColorType::DESKTOP;
-		}
-		else if (_wcsicmp(L"ACTIVECAPTION", colorType) == 0)
-		{
-			measure->colorType = ColorType::ACTIVECAPTION;
-		}
-		else if (_wcsicmp(L"INACTIVECAPTION", colorType) == 0)
-		{
-			measure->colorType = ColorType::INACTIVECAPTION;
-		}
-		else if (_wcsicmp(L"MENU", colorType) == 0)
-		{
-			measure->colorType = ColorType::MENU;
-		}
-		else if (_wcsicmp(L"WINDOW", colorType) == 0)
-		{
-			measure->colorType = ColorType::WINDOW;
-		}
-		else if (_wcsicmp(L"WINDOWFRAME", colorType) == 0)
-		{
-			measure->colorType = ColorType::WINDOWFRAME;
-		}
-		else if (_wcsicmp(L"MENUTEXT", colorType) == 0)
-		{
-			measure->colorType = ColorType::MENUTEXT;
-		}
-		else if (_wcsicmp(L"WINDOWTEXT", colorType) == 0)
-		{
-			measure->colorType = ColorType::WINDOWTEXT;
-		}
-		else if (_wcsicmp(L"CAPTIONTEXT", colorType) == 0)
-		{
-			measure->colorType = ColorType::CAPTIONTEXT;
-		}
-		else if (_wcsicmp(L"ACTIVEBORDER", colorType) == 0)
-		{
-			measure->colorType = ColorType::ACTIVEBORDER;
-		}
-		else if (_wcsicmp(L"INACTIVEBORDER", colorType) == 0)
-		{
-			measure->colorType = ColorType::INACTIVEBORDER;
-		}
-		else if (_wcsicmp(L"APPWORKSPACE", colorType) == 0)
-		{
-			measure->colorType = ColorType::APPWORKSPACE;
-		}
-		else if (_wcsicmp(L"HIGHLIGHT", colorType) == 0)
-		{
-			measure->colorType = ColorType::HIGHLIGHT;
-		}
-		else if (_wcsicmp(L"HIGHLIGHTTEXT", colorType) == 0)
+		std::wstring error;
+		measure->palette = GetPalette(path, error);
+		if (!measure->palette)
 		{
-			measure->colorType = ColorType::HIGHLIGHTTEXT;
+			RmLogF(rm, LOG_ERROR, L"SysColor: %s", error.c_str());
 		}
-		else if (_wcsicmp(L"BUTTONFACE", colorType) == 0)
-		{
-			measure->colorType = ColorType::BUTTONFACE;
-		}
-		else if (_wcsicmp(L"BUTTONSHADOW", colorType) == 0)
-		{
-			measure->colorType = ColorType::BUTTONSHADOW;
-		}
-		else if (_wcsicmp(L"GRAYTEXT", colorType) == 0)
-		{
-			measure->colorType = ColorType::GRAYTEXT;
-		}
-		else if (_wcsicmp(L"BUTTONTEXT", colorType) == 0)
-		{
-			measure->colorType = ColorType::BUTTONTEXT;
-		}
-		else if (_wcsicmp(L"INACTIVECAPTIONTEXT", colorType) == 0)
-		{
-			measure->colorType = ColorType::INACTIVECAPTIONTEXT;
-		}
-		else if (_wcsicmp(L"BUTTONHIGHLIGHT", colorType) == 0)
-		{
-			measure->colorType = ColorType::BUTTONHIGHLIGHT;
-		}
-		else if (_wcsicmp(L"3DDARKSHADOW", colorType) == 0)
-		{
-			measure->colorType = ColorType::DDARKSHADOW;
-		}
-		else if (_wcsicmp(L"3DLIGHT", colorType) == 0)
-		{
-			measure->colorType = ColorType::DLIGHT;
-		}
-		else if (_wcsicmp(L"TOOLTIPTEXT", colorType) == 0)
-		{
-			measure->colorType = ColorType::INFOTEXT;
-		}
-		else if (_wcsicmp(L"TOOLTIPBACKGROUND", colorType) == 0)
-		{
-			measure->colorType = ColorType::INFOBACKGROUND;
-		}
-		else if (_wcsicmp(L"HYPERLINK", colorType) == 0)
-		{
-			measure->colorType = ColorType::HOTLIGHT;
-		}
-		else if (_wcsicmp(L"ACTIVECAPTIONGRADIENT", colorType) == 0)
-		{
-			measure->colorType = ColorType::GRADIENTACTIVECAPTION;
-		}
-		else if (_wcsicmp(L"INACTIVECAPTIONGRADIENT", colorType) == 0)
-		{
-			measure->colorType = ColorType::GRADIENTINACTIVECAPTION;
-		}
-		else if (_wcsicmp(L"MENUHIGHLIGHT", colorType) == 0)
+	}
+
+	measure->transform.reset();
+	LPCWSTR transform = RmReadString(rm, L"Transform", L"");
+	if (*transform)
+	{
+		ColorMatrix matrix;
+		std::wstring error;
+		if (ParseColorMatrix(transform, matrix, error))
 		{
-			measure->colorType = ColorType::MENUHIGHLIGHT;
+			measure->transform = GetSnapshotTransform(matrix);
 		}
-		else if (_wcsicmp(L"MENUBAR", colorType) == 0)
+		else
 		{
-			measure->colorType = ColorType::MENUBAR;
+			RmLogF(rm, LOG_ERROR, L"SysColor: Invalid Transform: %s", error.c_str());
 		}
+	}
 
-		// Windows 7
-		else if (_wcsicmp(L"AERO", colorType) == 0)
-		{
-			measure->colorType = ColorType::WIN7_AERO;
-		}
+	// Derive and RampFrom/RampTo replace ColorType
+	measure->derive.Clear();
+	measure->rampFrom.Clear();
+	measure->rampTo.Clear();
+	measure->colorGeneration = UINT_MAX;  // Not built yet
 
-		// Windows 10/11
-		else if (_wcsicmp(L"ACCENT", colorType) == 0)
-		{
-			if (c_GetUserColorPreference && IsWindows10OrGreater())
-			{
-				measure->colorType = ColorType::ACCENT;
-			}
-			else
-			{
-				measure->colorType = ColorType::WIN7_AERO;
-				RmLog(rm, LOG_WARNING, L"SysColor: \"ColorType=Accent\" not available");
-			}
-		}
+	LPCWSTR derive = RmReadString(rm, L"Derive", L"");
+	if (*derive)
+	{
+		std::wstring error;
+		measure->colorType = ColorType::INVALID;
 
-		// Raw DWM values retrived from the undocumented function "DwmGetColorizationParameters"
-		else if (_wcsicmp(L"WIN8", colorType) == 0)
-		{
-			measure->colorType = ColorType::WIN8_WINDOW;
-		}
-		else if (_wcsicmp(L"DWM_COLOR", colorType) == 0)
+		if (!measure->derive.Compile(derive, error))
 		{
-			measure->colorType = ColorType::DWM_COLORIZATION_COLOR;
+			RmLogF(rm, LOG_ERROR, L"SysColor: Invalid Derive \"%s\": %s", derive, error.c_str());
 		}
-		else if (_wcsicmp(L"DWM_AFTERGLOW_COLOR", colorType) == 0)
+	}
+	else if (*RmReadString(rm, L"RampFrom", L""))
+	{
+		std::wstring error;
+		LPCWSTR option = L"RampFrom";
+		measure->colorType = ColorType::INVALID;
+
+		if (!measure->rampFrom.Compile(RmReadString(rm, option, L""), error) ||
+			!measure->rampTo.Compile(RmReadString(rm, option = L"RampTo", L""), error))
 		{
-			measure->colorType = ColorType::DWM_AFTERGLOW_COLOR;
+			RmLogF(rm, LOG_ERROR, L"SysColor: Invalid %s: %s", option, error.c_str());
+			measure->rampFrom.Clear();
+			measure->rampTo.Clear();
 		}
-		else if (_wcsicmp(L"DWM_COLOR_BALANCE", colorType) == 0)
+
+		const int steps = RmReadInt(rm, L"RampSteps", 5);
+		measure->rampSteps = max(2, min(steps, MAX_RAMP_STEPS));
+
+		LPCWSTR space = RmReadString(rm, L"RampSpace", L"sRGB");
+		if (_wcsicmp(L"sRGB", space) == 0)
 		{
-			measure->colorType = ColorType::DWM_COLOR_BALANCE;
+			measure->rampSpace = RampSpace::SRGB;
 		}
-		else if (_wcsicmp(L"DWM_AFTERGLOW_BALANCE", colorType) == 0)
+		else if (_wcsicmp(L"Linear", space) == 0)
 		{
-			measure->colorType = ColorType::DWM_AFTERGLOW_BALANCE;
+			measure->rampSpace = RampSpace::LINEAR;
 		}
-		else if (_wcsicmp(L"DWM_BLUR_BALANCE", colorType) == 0)
+		else if (_wcsicmp(L"OKLab", space) == 0)
 		{
-			measure->colorType = ColorType::DWM_BLUR_BALANCE;
+			measure->rampSpace = RampSpace::OKLAB;
 		}
-		else if (_wcsicmp(L"DWM_GLASS_REFLECTION_INTENSITY", colorType) == 0)
+		else
 		{
-			measure->colorType = ColorType::DWM_GLASS_REFLECTION_INTENSITY;
+			measure->rampSpace = RampSpace::SRGB;
+			RmLogF(rm, LOG_ERROR, L"SysColor: Unknown RampSpace: %s", space);
 		}
-		else if (_wcsicmp(L"DWM_OPAQUE_BLEND", colorType) == 0)
+	}
+	else
+	{
+		ColorType oldColorType = measure->colorType;
+		measure->colorType = ColorType::INVALID;
+
+		LPCWSTR colorType = RmReadString(rm, L"ColorType", L"ACCENT");
+		measure->colorType = GetColorTypeFromName(colorType);
+
+		// Windows 10/11
+		if (measure->colorType == ColorType::ACCENT && ResolveColorType(measure->colorType) != measure->colorType)
 		{
-			measure->colorType = ColorType::DWM_OPAQUE_BLEND;
+			measure->colorType = ResolveColorType(measure->colorType);
+			RmLog(rm, LOG_WARNING, L"SysColor: \"ColorType=Accent\" not available");
 		}
-		else if (oldColorType != measure->colorType)
+		else if (oldColorType != measure->colorType && measure->colorType == ColorType::INVALID)
 		{
 			RmLogF(rm, LOG_ERROR, L"Unknown ColorType: %s", colorType);
 		}
 	}
 
 	measure->isHex = 0 != RmReadInt(rm, L"Hex", 0);
+
+	ReleaseOutputSlot(measure->slot);
+	measure->slot = (measure->colorType != ColorType::INVALID) ?
+		AcquireOutputSlot(measure->colorType, measure->displayType, measure->isHex, measure->palette, measure->transform) : nullptr;
 }
 
 PLUGIN_EXPORT double Update(void* data)
 {
 	Measure* measure = (Measure*)data;
 
-	if (measure->colorType == ColorType::INVALID)
+	if (!measure->derive.IsEmpty())
 	{
+		// Only evaluated again when one of the colors used by the expression changed
+		const UINT generation = measure->derive.Refresh();
+		if (generation != measure->colorGeneration)
+		{
+			measure->colorGeneration = generation;
+
+			ColorF color;
+			const bool isValid = measure->derive.Evaluate(color);
+			if (isValid && measure->transform) measure->transform->Apply(&color, 1);
+
+			if (!isValid ||
+				!FormatColor(measure->color, PackColor(color), measure->displayType, measure->isHex, measure->palette.get()))
+			{
+				measure->color.clear();
+			}
+		}
+		return measure->color.empty() ? -1.0 : 1.0;
+	}
+
+	if (!measure->rampFrom.IsEmpty())
+	{
+		// Only built again when one of the colors used by the end points changed
+		// Refreshed before max(), which would evaluate the newer end twice
+		const UINT fromGeneration = measure->rampFrom.Refresh();
+		const UINT toGeneration = measure->rampTo.Refresh();
+		const UINT generation = max(fromGeneration, toGeneration);
+		if (generation != measure->colorGeneration)
+		{
+			measure->colorGeneration = generation;
+			BuildRampString(measure);
+		}
+		return measure->color.empty() ? -1.0 : 1.0;
+	}
+
+	OutputSlot* slot = measure->slot;
+	if (!slot)
+	{
+		// GetString falls back to the Derive/Ramp string, which may be left over from before a reload
 		measure->color.clear();
 		return -1.0;
 	}
 
-	int r = 0, g = 0, b = 0, a = 0;
-
-	if (measure->colorType == ColorType::WIN7_AERO)
+	// Only formatted by the first measure of the slot to see the change
+	const SnapshotEntry& entry = RefreshColor(slot->colorType);
+	if (entry.generation != slot->generation)
 	{
-		DWORD color = 0UL;
-		BOOL opaque = FALSE;
+		slot->generation = entry.generation;
 
-		// Color stored in 0xAARRGGBB format
-		HRESULT hr = DwmGetColorizationColor(&color, &opaque);
-		if (SUCCEEDED(hr))
+		if (!entry.isValid)
 		{
-			DWORD abgr = ToCOLORREF(color);
-			r = GetRValue(abgr);
-			g = GetGValue(abgr);
-			b = GetBValue(abgr);
-			a = GetAValue(abgr);
+			slot->color.clear();
+		}
+		else if (IsNumericColorType(slot->colorType))
+		{
+			slot->color = std::to_wstring(entry.value);
 		}
 		else
 		{
-			measure->color.clear();
-			return -1.0;
+			const COLORREF value = slot->transform ?
+				slot->transform->Get(GetColorTypeIndex(slot->colorType)) : entry.value;
+			FormatColor(slot->color, value, slot->displayType, slot->isHex, slot->palette.get());
 		}
 	}
 
-	// Windows 10/11
-	else if (measure->colorType == ColorType::ACCENT)
+	return slot->color.empty() ? -1.0 : 1.0;
+}
+
+PLUGIN_EXPORT LPCWSTR GetString(void* data)
+{
+	Measure* measure = (Measure*)data;
+	const std::wstring& color = measure->slot ? measure->slot->color : measure->color;
+	return color.empty() ? L"" : color.c_str();
+}
+
+PLUGIN_EXPORT void ExecuteBang(void* data, LPCWSTR args)
+{
+	Measure* measure = (Measure*)data;
+
+	if (_wcsnicmp(args, L"DumpHistory", 11) == 0)
 	{
-		if (!g_UxTheme)
+		LPCWSTR path = args + 11;
+		while (iswspace(*path)) ++path;
+
+		if (!*path)
 		{
-			measure->color.clear();
-			return -1.0;
+			RmLog(measure->rm, LOG_ERROR, L"SysColor: \"DumpHistory\" requires a file path");
+			return;
 		}
 
-		IMMERSIVE_COLOR_PREFERENCE immersiveColorPreference = { 0 };
-		HRESULT hr = c_GetUserColorPreference(&immersiveColorPreference, FALSE);
-		if (FAILED(hr))
+		path = RmPathToAbsolute(measure->rm, path);
+		if (!DumpHistory(path))
 		{
-			measure->color.clear();
-			return -1.0;
+			RmLogF(measure->rm, LOG_ERROR, L"SysColor: Could not write history to \"%s\"", path);
 		}
-
-		r = GetRValue(immersiveColorPreference.color2);
-		g = GetGValue(immersiveColorPreference.color2);
-		b = GetBValue(immersiveColorPreference.color2);
-		a = GetAValue(immersiveColorPreference.color2);
+		return;
 	}
 
-	// Raw DWM values (and WIN8_WINDOW)
-	else if (measure->colorType >= ColorType::WIN8_WINDOW)
+	// Provider commands affect all measures
+	if (_wcsnicmp(args, L"Record", 6) == 0 || _wcsnicmp(args, L"Replay", 6) == 0)
 	{
-		if (!g_DWMApi)  // Just in case
-		{
-			measure->color.clear();
-			return -1.0;
-		}
+		const bool isRecord = _wcsnicmp(args, L"Record", 6) == 0;
+		LPCWSTR path = args + 6;
+		while (iswspace(*path)) ++path;
 
-		BOOL isEnabled = FALSE;
-		HRESULT hr = DwmIsCompositionEnabled(&isEnabled);
-		if (FAILED(hr))
+		if (!*path)
 		{
-			measure->color.clear();
-			return -1.0;
+			RmLogF(measure->rm, LOG_ERROR, L"SysColor: \"%s\" requires a file path", isRecord ? L"Record" : L"Replay");
+			return;
 		}
 
-		DWMColorizationParameters params;
-		hr = c_DwmGetColorizationParameters(&params);
-		if (FAILED(hr))
+		path = RmPathToAbsolute(measure->rm, path);
+		StopProvider(measure->rm);  // Stop any previous recording/replay
+
+		if (isRecord)
 		{
-			measure->color.clear();
-			return -1.0;
+			RecordingProvider* provider = new RecordingProvider(GetProvider());
+			if (provider->Open(path))
+			{
+				SetProvider(provider);
+				return;
+			}
+			delete provider;
 		}
-
-		// COLORREF is stored in 0xAABBGGRR format, but the color is stored in 0xAARRGGBB format.
-		DWORD color = ToCOLORREF((measure->colorType == ColorType::DWM_AFTERGLOW_COLOR) ?
-			params.colorizationAfterglow : params.colorizationColor);
-		r = GetRValue(color);
-		g = GetGValue(color);
-		b = GetBValue(color);
-		a = GetAValue(color);
-
-		switch (measure->colorType)
+		else
 		{
-		case ColorType::WIN8_WINDOW:
+			ReplayProvider* provider = new ReplayProvider;
+			if (provider->Open(path))
 			{
-				double bal = 100.0 - params.colorizationColorBalance;
-
-				r = min((int)round(r + (217 - r) * bal / 100.0), 255);
-				g = min((int)round(g + (217 - g) * bal / 100.0), 255);
-				b = min((int)round(b + (217 - b) * bal / 100.0), 255);
+				SetProvider(provider);
+				return;
 			}
-			break;
-
-		case ColorType::DWM_COLORIZATION_COLOR:
-		case ColorType::DWM_AFTERGLOW_COLOR:
-			// Values already calculated
-			break;
+			delete provider;
+		}
 
-		case ColorType::DWM_COLOR_BALANCE:
-			measure->color = std::to_wstring(params.colorizationColorBalance);
-			return 1.0;
+		RmLogF(measure->rm, LOG_ERROR, L"SysColor: Could not open \"%s\"", path);
+		return;
+	}
 
-		case ColorType::DWM_AFTERGLOW_BALANCE:
-			measure->color = std::to_wstring(params.colorizationAfterglowBalance);
-			return 1.0;
+	// Freedesktop [ConfigDir] - GTK/KDE theme files, ~/.config (or $XDG_CONFIG_HOME) by default
+	if (_wcsnicmp(args, L"Freedesktop", 11) == 0)
+	{
+		LPCWSTR path = args + 11;
+		while (iswspace(*path)) ++path;
 
-		case ColorType::DWM_BLUR_BALANCE:
-			measure->color = std::to_wstring(params.colorizationBlurBalance);
-			return 1.0;
+		const std::string configDir = *path ?
+			Narrow(RmPathToAbsolute(measure->rm, path), -1, CP_UTF8) : GetFreedesktopConfigDir();
 
-		case ColorType::DWM_GLASS_REFLECTION_INTENSITY:
-			measure->color = std::to_wstring(params.colorizationGlassReflectionIntensity);
-			return 1.0;
+		StopProvider(measure->rm);
 
-		case ColorType::DWM_OPAQUE_BLEND:
-			measure->color = std::to_wstring(params.colorizationOpaqueBlend);
-			return 1.0;
+		FreedesktopProvider* provider = new FreedesktopProvider;
+		if (!configDir.empty() && provider->Open(configDir))
+		{
+			SetProvider(provider);
+			return;
 		}
+		delete provider;
+
+		RmLogF(measure->rm, LOG_ERROR, L"SysColor: No theme files found in \"%s\"", Widen(configDir.c_str(), -1, CP_UTF8).c_str());
+		return;
 	}
 
-	// GetSysColorBrush
-	else
+	if (_wcsicmp(args, L"Live") == 0)
 	{
-		HBRUSH hBrush = GetSysColorBrush((int)measure->colorType);
-		LOGBRUSH lb = { 0 };
-		if (GetObject(hBrush, sizeof(LOGBRUSH), (LPSTR)&lb) <= 0 || !hBrush)
-		{
-			if (hBrush) DeleteObject(hBrush);
+		StopProvider(measure->rm);
+		return;
+	}
 
-			measure->color.clear();
-			return -1.0;
-		}
+	RmLogF(measure->rm, LOG_ERROR, L"SysColor: Unknown command: %s", args);
+}
 
-		r = GetRValue(lb.lbColor);
-		g = GetGValue(lb.lbColor);
-		b = GetBValue(lb.lbColor);
-		a = 0;
+// [&Measure:LastChanges(N)] - The last N changes of the snapshot (most recent first), one per line
+PLUGIN_EXPORT LPCWSTR LastChanges(void* data, const int argc, const WCHAR* argv[])
+{
+	Measure* measure = (Measure*)data;
+	const int count = (argc > 0) ? _wtoi(argv[0]) : 1;
 
-		DeleteObject(hBrush);
-	}
+	measure->functionResult.clear();
 
-	bool hex = measure->isHex;
-	switch (measure->displayType)
+	HistoryEntry entry;
+	for (UINT age = 0U; (int)age < count && GetHistoryEntry(age, entry); ++age)
 	{
-	case DisplayType::RED:
-		measure->color = ColorToString(r, hex);
-		break;
+		if (age > 0U) measure->functionResult += L'\n';
+		measure->functionResult += FormatHistoryEntry(entry);
+	}
 
-	case DisplayType::GREEN:
-		measure->color = ColorToString(g, hex);
-		break;
+	return measure->functionResult.c_str();
+}
 
-	case DisplayType::BLUE:
-		measure->color = ColorToString(b, hex);
-		break;
+// [&Measure:SinceLastChange(ColorType)] - Seconds since |ColorType| (or any color if omitted) last changed, -1 if unknown
+PLUGIN_EXPORT LPCWSTR SinceLastChange(void* data, const int argc, const WCHAR* argv[])
+{
+	Measure* measure = (Measure*)data;
 
-	case DisplayType::ALPHA:
-		if (a)
+	ColorType type = ColorType::INVALID;
+	if (argc > 0 && *argv[0])
+	{
+		// Same fallback as ColorType and Derive, so "Accent" finds the "Aero" changes on Windows 7/8
+		type = ResolveColorType(GetColorTypeFromName(argv[0]));
+		if (type == ColorType::INVALID)
 		{
-			measure->color = ColorToString(a, hex);
-			break;
+			RmLogF(measure->rm, LOG_ERROR, L"SysColor: Unknown ColorType: %s", argv[0]);
+			return L"-1";
 		}
-		measure->color.clear();
-		return -1.0;
+	}
 
-	case DisplayType::RGB:
-		measure->color = ColorToString(r, hex);  // Red
-		if (!hex) measure->color += L",";
+	HistoryEntry entry;
+	if (!FindLastChange(type, entry)) return L"-1";
 
-		measure->color += ColorToString(g, hex);  // Green
-		if (!hex) measure->color += L",";
+	measure->functionResult = std::to_wstring((GetTickCount64() - entry.tick) / 1000ULL);
+	return measure->functionResult.c_str();
+}
 
-		measure->color += ColorToString(b, hex);  // Blue
-		break;
+// Batch query for other plugins and tools in the process (call from the thread that runs the
+// measures). Retrieves the first |count| ColorTypes, in the order of GetColorTypeNameAt, into
+// |colors|: packed 0xAABBGGRR colors (or the raw value of numeric ColorTypes), 0 if not retrieved.
+// System colors have no alpha channel, so they are returned opaque (alpha 0xFF). Bit N of
+// |validMask| is set if colors[N] was retrieved. Returns the snapshot generation, which only changes
+// when a value changes. With |colors| of nullptr, only the generation is returned. The DWM values
+// are all read from one set of DWM calls.
+PLUGIN_EXPORT UINT GetAllColors(COLORREF* colors, UINT count, ULONGLONG* validMask)
+{
+	static_assert(COLORTYPE_COUNT <= 64, "validMask too small for COLORTYPE_COUNT");
 
-	case DisplayType::ALL:
-		measure->color = ColorToString(r, hex);  // Red
-		if (!hex) measure->color += L",";
+	ULONGLONG mask = 0ULL;
+	count = colors ? min(count, (UINT)COLORTYPE_COUNT) : 0U;
+
+	// Shared by WIN8_WINDOW and the raw DWM ColorTypes, retrieved once per batch
+	DWMColorizationParameters params = { 0 };
+	bool isDwmRetrieved = false;
+	bool isDwmValid = false;
 
-		measure->color += ColorToString(g, hex);  // Green
-		if (!hex) measure->color += L",";
+	for (UINT i = 0U; i < count; ++i)
+	{
+		const ColorType type = c_ColorTypes[i].type;
 
-		measure->color += ColorToString(b, hex);  // Blue
+		COLORREF value = 0UL;
+		bool isValid = false;
+		if (type >= ColorType::WIN8_WINDOW)
+		{
+			if (!isDwmRetrieved)
+			{
+				isDwmValid = RetrieveDwmParameters(params);
+				isDwmRetrieved = true;
+			}
+			isValid = isDwmValid && GetDwmValue(type, params, value);
+		}
+		else
+		{
+			isValid = RetrieveColor(type, value);
+		}
 
-		if (a > 0)
+		const SnapshotEntry& entry = StoreColor(type, isValid, value);
+		if (!entry.isValid)
 		{
-			if (!hex) measure->color += L",";
-			measure->color += ColorToString(a, hex);  // Alpha
+			colors[i] = 0UL;
+			continue;
 		}
-		break;
+
+		colors[i] = HasAlpha(type) ? entry.value : (entry.value | 0xFF000000UL);
+		mask |= 1ULL << i;
 	}
 
-	return measure->color.empty() ? -1.0 : 1.0;
+	if (validMask) *validMask = mask;
+	return g_Snapshot.generation.load();
 }
 
-PLUGIN_EXPORT LPCWSTR GetString(void* data)
+// Name of the ColorType at |index| of GetAllColors, nullptr past the last ColorType
+PLUGIN_EXPORT LPCWSTR GetColorTypeNameAt(UINT index)
 {
-	Measure* measure = (Measure*)data;
-	return measure->color.empty() ? L"" : measure->color.c_str();
+	return (index < (UINT)COLORTYPE_COUNT) ? c_ColorTypes[index].name : nullptr;
 }
 
 PLUGIN_EXPORT void Finalize(void* data)
 {
 	Measure* measure = (Measure*)data;
 
+	ReleaseOutputSlot(measure->slot);
 	delete measure;
 	measure = nullptr;
 
@@ -723,6 +1175,8 @@ PLUGIN_EXPORT void Finalize(void* data)
 
 	if (g_Instances == 0U)
 	{
+		SetProvider(nullptr);
+
 		if (g_DWMApi)
 		{
 			FreeLibrary(g_DWMApi);
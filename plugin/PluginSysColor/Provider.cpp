@@ -0,0 +1,306 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "Provider.h"
+
+RecordingProvider::RecordingProvider(ColorProvider* source) :
+	m_Source(source),
+	m_File(nullptr),
+	m_Written(0U),
+	m_Failed(false)
+{
+}
+
+RecordingProvider::~RecordingProvider()
+{
+	if (m_File)
+	{
+		fclose(m_File);
+		m_File = nullptr;
+	}
+}
+
+bool RecordingProvider::Open(LPCWSTR path)
+{
+	if (_wfopen_s(&m_File, path, L"wb") != 0 || !m_File) return false;
+
+	const ProviderLogHeader header = { PROVIDERLOG_MAGIC, PROVIDERLOG_VERSION, (uint32_t)sizeof(ProviderLogRecord), 0U };
+	return fwrite(&header, sizeof(header), 1, m_File) == 1;
+}
+
+void RecordingProvider::Write(ProviderCall call, DWORD argument, HRESULT result, const void* data, size_t size)
+{
+	if (m_Failed) return;
+
+	ProviderLogRecord record = { call, (uint32_t)argument, (int32_t)result, { 0U } };
+	if (SUCCEEDED(result) && data)
+	{
+		memcpy(record.data, data, size);
+	}
+
+	// A partial record would misalign the rest of the log, so stop at the first failure
+	if (fwrite(&record, sizeof(record), 1, m_File) != 1 ||
+		(++m_Written % FLUSH_INTERVAL == 0U && fflush(m_File) != 0))
+	{
+		m_Failed = true;
+	}
+}
+
+HRESULT RecordingProvider::GetColorizationColor(DWORD* color, BOOL* opaque)
+{
+	HRESULT hr = m_Source->GetColorizationColor(color, opaque);
+	const DWORD data[2] = { *color, (DWORD)*opaque };
+	Write(ProviderCall::COLORIZATION_COLOR, 0UL, hr, data, sizeof(data));
+	return hr;
+}
+
+HRESULT RecordingProvider::GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference)
+{
+	HRESULT hr = m_Source->GetUserColorPreference(preference);
+	Write(ProviderCall::USER_COLOR_PREFERENCE, 0UL, hr, preference, sizeof(*preference));
+	return hr;
+}
+
+HRESULT RecordingProvider::IsCompositionEnabled(BOOL* enabled)
+{
+	HRESULT hr = m_Source->IsCompositionEnabled(enabled);
+	Write(ProviderCall::COMPOSITION_ENABLED, 0UL, hr, enabled, sizeof(*enabled));
+	return hr;
+}
+
+HRESULT RecordingProvider::GetColorizationParameters(COLORIZATIONPARAMS* params)
+{
+	HRESULT hr = m_Source->GetColorizationParameters(params);
+	Write(ProviderCall::COLORIZATION_PARAMETERS, 0UL, hr, params, sizeof(*params));
+	return hr;
+}
+
+bool RecordingProvider::GetSysColor(int index, COLORREF* color)
+{
+	bool result = m_Source->GetSysColor(index, color);
+	Write(ProviderCall::SYS_COLOR, (DWORD)index, result ? S_OK : E_FAIL, color, sizeof(*color));
+	return result;
+}
+
+ReplayProvider::ReplayProvider() :
+	m_File(INVALID_HANDLE_VALUE),
+	m_Mapping(nullptr),
+	m_View(nullptr),
+	m_Cursor()
+{
+}
+
+ReplayProvider::~ReplayProvider()
+{
+	Close();
+}
+
+bool ReplayProvider::Open(LPCWSTR path)
+{
+	m_File = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size = { 0 };
+	if (!GetFileSizeEx(m_File, &size) || size.QuadPart < (LONGLONG)(sizeof(ProviderLogHeader) + sizeof(ProviderLogRecord)))
+	{
+		Close();
+		return false;
+	}
+
+	m_Mapping = CreateFileMapping(m_File, nullptr, PAGE_READONLY, 0UL, 0UL, nullptr);
+	m_View = m_Mapping ? MapViewOfFile(m_Mapping, FILE_MAP_READ, 0UL, 0UL, 0) : nullptr;
+	if (!m_View)
+	{
+		Close();
+		return false;
+	}
+
+	const ProviderLogHeader* header = (const ProviderLogHeader*)m_View;
+	if (!IsValidProviderLogHeader(*header))
+	{
+		Close();
+		return false;
+	}
+
+	const size_t count = (size_t)(size.QuadPart - sizeof(ProviderLogHeader)) / sizeof(ProviderLogRecord);
+	m_Cursor.Reset((const ProviderLogRecord*)(header + 1), count);
+	return true;
+}
+
+void ReplayProvider::Close()
+{
+	if (m_View)
+	{
+		UnmapViewOfFile(m_View);
+		m_View = nullptr;
+	}
+
+	if (m_Mapping)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+
+	if (m_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+
+	m_Cursor.Reset(nullptr, 0);
+}
+
+HRESULT ReplayProvider::GetColorizationColor(DWORD* color, BOOL* opaque)
+{
+	const ProviderLogRecord* record = m_Cursor.Next(ProviderCall::COLORIZATION_COLOR, 0U);
+	if (!record) return E_FAIL;
+
+	*color = record->data[0];
+	*opaque = (BOOL)record->data[1];
+	return record->result;
+}
+
+HRESULT ReplayProvider::GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference)
+{
+	const ProviderLogRecord* record = m_Cursor.Next(ProviderCall::USER_COLOR_PREFERENCE, 0U);
+	if (!record) return E_FAIL;
+
+	memcpy(preference, record->data, sizeof(*preference));
+	return record->result;
+}
+
+HRESULT ReplayProvider::IsCompositionEnabled(BOOL* enabled)
+{
+	const ProviderLogRecord* record = m_Cursor.Next(ProviderCall::COMPOSITION_ENABLED, 0U);
+	if (!record) return E_FAIL;
+
+	*enabled = (BOOL)record->data[0];
+	return record->result;
+}
+
+HRESULT ReplayProvider::GetColorizationParameters(COLORIZATIONPARAMS* params)
+{
+	const ProviderLogRecord* record = m_Cursor.Next(ProviderCall::COLORIZATION_PARAMETERS, 0U);
+	if (!record) return E_FAIL;
+
+	memcpy(params, record->data, sizeof(*params));
+	return record->result;
+}
+
+bool ReplayProvider::GetSysColor(int index, COLORREF* color)
+{
+	const ProviderLogRecord* record = m_Cursor.Next(ProviderCall::SYS_COLOR, (uint32_t)index);
+	if (!record) return false;
+
+	*color = record->data[0];
+	return SUCCEEDED(record->result);
+}
+
+namespace
+{
+
+struct SysColorMapping
+{
+	int index;
+	ThemeColor color;
+};
+
+const SysColorMapping c_SysColorMappings[] =
+{
+	{ COLOR_ACTIVECAPTION, ThemeColor::TITLEBAR },
+	{ COLOR_INACTIVECAPTION, ThemeColor::TITLEBAR_INACTIVE },
+	{ COLOR_MENU, ThemeColor::WINDOW },
+	{ COLOR_WINDOW, ThemeColor::VIEW },
+	{ COLOR_MENUTEXT, ThemeColor::WINDOW_TEXT },
+	{ COLOR_WINDOWTEXT, ThemeColor::VIEW_TEXT },
+	{ COLOR_CAPTIONTEXT, ThemeColor::TITLEBAR_TEXT },
+	{ COLOR_APPWORKSPACE, ThemeColor::WINDOW },
+	{ COLOR_HIGHLIGHT, ThemeColor::SELECTION },
+	{ COLOR_HIGHLIGHTTEXT, ThemeColor::SELECTION_TEXT },
+	{ COLOR_BTNFACE, ThemeColor::BUTTON },
+	{ COLOR_GRAYTEXT, ThemeColor::DISABLED_TEXT },
+	{ COLOR_BTNTEXT, ThemeColor::BUTTON_TEXT },
+	{ COLOR_INACTIVECAPTIONTEXT, ThemeColor::TITLEBAR_INACTIVE_TEXT },
+	{ COLOR_INFOTEXT, ThemeColor::TOOLTIP_TEXT },
+	{ COLOR_INFOBK, ThemeColor::TOOLTIP },
+	{ COLOR_HOTLIGHT, ThemeColor::LINK },
+	{ COLOR_GRADIENTACTIVECAPTION, ThemeColor::TITLEBAR },
+	{ COLOR_GRADIENTINACTIVECAPTION, ThemeColor::TITLEBAR_INACTIVE },
+	{ COLOR_MENUHILIGHT, ThemeColor::SELECTION },
+	{ COLOR_MENUBAR, ThemeColor::WINDOW }
+};
+
+// 0xAABBGGRR to 0xAARRGGBB
+DWORD ToARGB(uint32_t color)
+{
+	return (color & 0xFF00FF00UL) | ((color & 0xFFUL) << 16) | ((color >> 16) & 0xFFUL);
+}
+
+};  // namespace
+
+bool FreedesktopProvider::Open(const std::string& configDir)
+{
+	m_ConfigDir = configDir;
+	if (LoadFreedesktopTheme(m_ConfigDir, m_Theme) == 0) return false;
+
+	// Without a watcher, the theme is read once
+	m_Watcher.Start(m_ConfigDir);
+	return true;
+}
+
+const FreedesktopTheme& FreedesktopProvider::GetTheme()
+{
+	if (m_Watcher.HasChanged())
+	{
+		LoadFreedesktopTheme(m_ConfigDir, m_Theme);
+	}
+
+	return m_Theme;
+}
+
+HRESULT FreedesktopProvider::GetColorizationColor(DWORD* color, BOOL* opaque)
+{
+	*color = ToARGB(GetTheme().Get(ThemeColor::ACCENT));
+	*opaque = TRUE;
+	return S_OK;
+}
+
+HRESULT FreedesktopProvider::GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference)
+{
+	const FreedesktopTheme& theme = GetTheme();
+	preference->color1 = theme.Get(ThemeColor::WINDOW);
+	preference->color2 = theme.Get(ThemeColor::ACCENT);
+	return S_OK;
+}
+
+HRESULT FreedesktopProvider::IsCompositionEnabled(BOOL* enabled)
+{
+	*enabled = TRUE;
+	return S_OK;
+}
+
+HRESULT FreedesktopProvider::GetColorizationParameters(COLORIZATIONPARAMS* params)
+{
+	// Opaque accent at full intensity
+	const DWORD accent = ToARGB(GetTheme().Get(ThemeColor::ACCENT));
+	*params = { accent, accent, 100U, 0U, 0U, 0U, TRUE };
+	return S_OK;
+}
+
+bool FreedesktopProvider::GetSysColor(int index, COLORREF* color)
+{
+	for (const auto& mapping : c_SysColorMappings)
+	{
+		if (mapping.index != index) continue;
+
+		// System colors have no alpha channel
+		*color = GetTheme().Get(mapping.color) & 0x00FFFFFFUL;
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,123 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include <Windows.h>
+#include <stdio.h>
+#include "Freedesktop.h"
+#include "ProviderLog.h"
+
+typedef struct COLORIZATIONPARAMS
+{
+	COLORREF	colorizationColor;
+	COLORREF	colorizationAfterglow;
+	UINT		colorizationColorBalance;
+	UINT		colorizationAfterglowBalance;
+	UINT		colorizationBlurBalance;
+	UINT		colorizationGlassReflectionIntensity;
+	BOOL		colorizationOpaqueBlend;
+} DWMColorizationParameters;
+
+typedef struct IMMERSIVE_COLOR_PREFERENCE
+{
+	COLORREF color1;
+	COLORREF color2;
+} ImmersiveColorPreference;
+
+// Every call the plugin makes to the OS to retrieve a color goes through a provider. The results
+// are returned exactly as the OS returned them, all color calculations are done by the caller.
+class ColorProvider
+{
+public:
+	virtual ~ColorProvider() { }
+
+	virtual HRESULT GetColorizationColor(DWORD* color, BOOL* opaque) = 0;				// DwmGetColorizationColor
+	virtual HRESULT GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference) = 0;	// uxtheme.dll:GetUserColorPreference
+	virtual HRESULT IsCompositionEnabled(BOOL* enabled) = 0;							// DwmIsCompositionEnabled
+	virtual HRESULT GetColorizationParameters(COLORIZATIONPARAMS* params) = 0;			// dwmapi.dll:DwmGetColorizationParameters
+	virtual bool GetSysColor(int index, COLORREF* color) = 0;							// GetSysColorBrush
+};
+
+ColorProvider* GetProvider();
+void SetProvider(ColorProvider* provider);  // nullptr restores the live provider
+
+static_assert(sizeof(COLORIZATIONPARAMS) <= sizeof(ProviderLogRecord::data), "ProviderLogRecord too small");
+
+// Forwards all calls to |source| and appends every result to the log. The log is flushed every
+// FLUSH_INTERVAL records, and no longer written after a failed write.
+class RecordingProvider : public ColorProvider
+{
+public:
+	RecordingProvider(ColorProvider* source);
+	~RecordingProvider();
+
+	bool Open(LPCWSTR path);
+	bool HasFailed() const { return m_Failed; }
+
+	HRESULT GetColorizationColor(DWORD* color, BOOL* opaque) override;
+	HRESULT GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference) override;
+	HRESULT IsCompositionEnabled(BOOL* enabled) override;
+	HRESULT GetColorizationParameters(COLORIZATIONPARAMS* params) override;
+	bool GetSysColor(int index, COLORREF* color) override;
+
+private:
+	void Write(ProviderCall call, DWORD argument, HRESULT result, const void* data, size_t size);
+
+	static constexpr UINT FLUSH_INTERVAL = 256U;
+
+	ColorProvider* m_Source;
+	FILE* m_File;
+	UINT m_Written;
+	bool m_Failed;
+};
+
+// Returns the recorded results of a memory-mapped log, in the order of ProviderLogCursor
+class ReplayProvider : public ColorProvider
+{
+public:
+	ReplayProvider();
+	~ReplayProvider();
+
+	bool Open(LPCWSTR path);
+	UINT GetMismatches() const { return m_Cursor.GetMismatches(); }
+
+	HRESULT GetColorizationColor(DWORD* color, BOOL* opaque) override;
+	HRESULT GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference) override;
+	HRESULT IsCompositionEnabled(BOOL* enabled) override;
+	HRESULT GetColorizationParameters(COLORIZATIONPARAMS* params) override;
+	bool GetSysColor(int index, COLORREF* color) override;
+
+private:
+	void Close();
+
+	HANDLE m_File;
+	HANDLE m_Mapping;
+	const void* m_View;
+	ProviderLogCursor m_Cursor;
+};
+
+// Colors of a freedesktop (GTK/KDE) theme, returned as Windows would return them. The theme files
+// are only read again when the watcher reports a change.
+class FreedesktopProvider : public ColorProvider
+{
+public:
+	bool Open(const std::string& configDir);
+
+	HRESULT GetColorizationColor(DWORD* color, BOOL* opaque) override;
+	HRESULT GetUserColorPreference(IMMERSIVE_COLOR_PREFERENCE* preference) override;
+	HRESULT IsCompositionEnabled(BOOL* enabled) override;
+	HRESULT GetColorizationParameters(COLORIZATIONPARAMS* params) override;
+	bool GetSysColor(int index, COLORREF* color) override;
+
+private:
+	const FreedesktopTheme& GetTheme();
+
+	std::string m_ConfigDir;
+	FreedesktopTheme m_Theme;
+	ThemeWatcher m_Watcher;
+};
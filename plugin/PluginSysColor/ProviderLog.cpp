@@ -0,0 +1,60 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "ProviderLog.h"
+
+bool IsValidProviderLogHeader(const ProviderLogHeader& header)
+{
+	return header.magic == PROVIDERLOG_MAGIC && header.version == PROVIDERLOG_VERSION &&
+		header.recordSize == sizeof(ProviderLogRecord);
+}
+
+bool ReadProviderLogHeader(FILE* file)
+{
+	ProviderLogHeader header = { };
+	return fread(&header, sizeof(header), 1, file) == 1 && IsValidProviderLogHeader(header);
+}
+
+bool ReadProviderLogRecord(FILE* file, ProviderLogRecord& record)
+{
+	// A partial record at the end (eg. from a recording that was not stopped) is ignored
+	return fread(&record, sizeof(record), 1, file) == 1;
+}
+
+ProviderLogCursor::ProviderLogCursor() :
+	m_Records(nullptr),
+	m_Count(0),
+	m_Position(0),
+	m_Mismatches(0U)
+{
+}
+
+void ProviderLogCursor::Reset(const ProviderLogRecord* records, size_t count)
+{
+	m_Records = records;
+	m_Count = records ? count : 0;
+	m_Position = 0;
+	m_Mismatches = 0U;
+}
+
+const ProviderLogRecord* ProviderLogCursor::Next(ProviderCall call, uint32_t argument)
+{
+	for (size_t i = 0; i < m_Count; ++i)
+	{
+		const ProviderLogRecord* record = &m_Records[m_Position];
+		m_Position = (m_Position + 1) % m_Count;
+
+		if (record->call == call && record->argument == argument)
+		{
+			if (i != 0) ++m_Mismatches;
+			return record;
+		}
+	}
+
+	++m_Mismatches;
+	return nullptr;
+}
@@ -0,0 +1,80 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+// Layout of the provider log written by the Record command. This file only depends on the C/C++
+// runtime, so logs can also be read on Linux (eg. to replay them in tests).
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Provider log: a header followed by fixed size records, one per provider call, in call order.
+// The records are read straight from the mapped file when replayed.
+constexpr uint32_t PROVIDERLOG_MAGIC = 0x4C524353U;  // "SCRL"
+constexpr uint32_t PROVIDERLOG_VERSION = 1U;
+
+enum class ProviderCall : uint32_t
+{
+	COLORIZATION_COLOR = 1U,
+	USER_COLOR_PREFERENCE,
+	COMPOSITION_ENABLED,
+	COLORIZATION_PARAMETERS,
+	SYS_COLOR
+};
+
+struct ProviderLogHeader
+{
+	uint32_t magic;
+	uint32_t version;
+	uint32_t recordSize;
+	uint32_t reserved;
+};
+
+struct ProviderLogRecord
+{
+	ProviderCall call;
+	uint32_t argument;	// Index for SYS_COLOR
+	int32_t result;		// HRESULT, S_OK/E_FAIL for SYS_COLOR
+	uint32_t data[7];	// Output of the call (COLORIZATIONPARAMS is the largest)
+};
+
+static_assert(sizeof(ProviderLogHeader) == 16 && sizeof(ProviderLogRecord) == 40, "Provider log layout changed");
+
+bool IsValidProviderLogHeader(const ProviderLogHeader& header);
+
+// Reads the header of |file|. Returns false if it is not a provider log of this version.
+bool ReadProviderLogHeader(FILE* file);
+
+// Reads the next record of |file|. Returns false at the end of the log.
+bool ReadProviderLogRecord(FILE* file, ProviderLogRecord& record);
+
+// Position in the records of a log, as used by the Replay command. Calls are matched to the records
+// in the recorded order. When a call does not match the next record, the records are searched
+// (wrapping around) for the next record of the same call and the mismatch is counted. The log loops
+// at the end.
+class ProviderLogCursor
+{
+public:
+	ProviderLogCursor();
+
+	// |records| must stay valid while the cursor is used
+	void Reset(const ProviderLogRecord* records, size_t count);
+
+	// nullptr if no record matches |call| and |argument|
+	const ProviderLogRecord* Next(ProviderCall call, uint32_t argument);
+
+	size_t GetPosition() const { return m_Position; }
+	uint32_t GetMismatches() const { return m_Mismatches; }
+
+private:
+	const ProviderLogRecord* m_Records;
+	size_t m_Count;
+	size_t m_Position;
+	uint32_t m_Mismatches;
+};
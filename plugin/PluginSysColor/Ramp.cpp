@@ -0,0 +1,90 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "Ramp.h"
+#include <initializer_list>
+
+namespace
+{
+
+// Channels of all stops are kept in separate arrays so the loops below have no dependencies
+// between iterations and can be vectorized by the compiler.
+struct RampChannels
+{
+	float c0[MAX_RAMP_STEPS];
+	float c1[MAX_RAMP_STEPS];
+	float c2[MAX_RAMP_STEPS];
+	float a[MAX_RAMP_STEPS];
+};
+
+void Interpolate(const float from[4], const float to[4], int steps, RampChannels& out)
+{
+	const float d0 = to[0] - from[0];
+	const float d1 = to[1] - from[1];
+	const float d2 = to[2] - from[2];
+	const float d3 = to[3] - from[3];
+	const float step = 1.0f / (float)(steps - 1);
+
+	for (int i = 0; i < steps; ++i)
+	{
+		const float t = (float)i * step;
+		out.c0[i] = from[0] + d0 * t;
+		out.c1[i] = from[1] + d1 * t;
+		out.c2[i] = from[2] + d2 * t;
+		out.a[i] = from[3] + d3 * t;
+	}
+}
+
+};  // namespace
+
+void BuildRamp(const ColorF& from, const ColorF& to, int steps, RampSpace space, ColorF* stops)
+{
+	RampChannels channels;
+	float f[4] = { from.r, from.g, from.b, from.a };
+	float t[4] = { to.r, to.g, to.b, to.a };
+
+	// Convert the end points only, the stops are converted back in bulk
+	if (space != RampSpace::SRGB)
+	{
+		for (float* c : { f, t })
+		{
+			c[0] = SrgbToLinear(c[0]);
+			c[1] = SrgbToLinear(c[1]);
+			c[2] = SrgbToLinear(c[2]);
+
+			if (space == RampSpace::OKLAB)
+			{
+				LinearToOklab(c[0], c[1], c[2], c[0], c[1], c[2]);
+			}
+		}
+	}
+
+	Interpolate(f, t, steps, channels);
+
+	if (space == RampSpace::OKLAB)
+	{
+		for (int i = 0; i < steps; ++i)
+		{
+			OklabToLinear(channels.c0[i], channels.c1[i], channels.c2[i], channels.c0[i], channels.c1[i], channels.c2[i]);
+		}
+	}
+
+	if (space != RampSpace::SRGB)
+	{
+		for (int i = 0; i < steps; ++i)
+		{
+			channels.c0[i] = LinearToSrgb(channels.c0[i]);
+			channels.c1[i] = LinearToSrgb(channels.c1[i]);
+			channels.c2[i] = LinearToSrgb(channels.c2[i]);
+		}
+	}
+
+	for (int i = 0; i < steps; ++i)
+	{
+		stops[i] = { channels.c0[i], channels.c1[i], channels.c2[i], channels.a[i] };
+	}
+}
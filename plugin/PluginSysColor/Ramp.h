@@ -0,0 +1,23 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include "ColorMath.h"
+
+enum class RampSpace : int
+{
+	SRGB = 0,		// Interpolates the channels as they are
+	LINEAR,			// Interpolates in linear light
+	OKLAB			// Interpolates in the (perceptual) OKLab space
+};
+
+constexpr int MAX_RAMP_STEPS = 256;
+
+// Fills |stops| with |steps| colors from |from| to |to| (both included). Alpha is always
+// interpolated linearly. |steps| must be between 2 and MAX_RAMP_STEPS.
+void BuildRamp(const ColorF& from, const ColorF& to, int steps, RampSpace space, ColorF* stops);
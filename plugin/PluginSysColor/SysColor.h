@@ -0,0 +1,140 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include <Windows.h>
+#include <atomic>
+#include <string>
+#include "ColorMath.h"
+
+#define GetAValue(rgb)			(LOBYTE((rgb) >> 24))
+#define RGBA(r, g, b, a)		(RGB(r, g, b) | ((COLORREF)(BYTE)(a) << 24))
+
+enum class ColorType : int
+{
+	INVALID = -1,
+
+	// Values to use with GetSysColorBrush (WinUser.h)
+	// Values documented here: https://learn.microsoft.com/en-us/windows/win32/api/winuser/nf-winuser-getsyscolor
+	// Note: Most of these are supposedly not supported by Windows 10+, but they still work (for now)
+	//       even if the OS doesn't use them much anymore
+	SCROLLBAR = COLOR_SCROLLBAR,
+	DESKTOP = COLOR_DESKTOP,
+	ACTIVECAPTION = COLOR_ACTIVECAPTION,
+	INACTIVECAPTION = COLOR_INACTIVECAPTION,
+	MENU = COLOR_MENU,
+	WINDOW = COLOR_WINDOW,
+	WINDOWFRAME = COLOR_WINDOWFRAME,
+	MENUTEXT = COLOR_MENUTEXT,
+	WINDOWTEXT = COLOR_WINDOWTEXT,
+	CAPTIONTEXT = COLOR_CAPTIONTEXT,
+	ACTIVEBORDER = COLOR_ACTIVEBORDER,
+	INACTIVEBORDER = COLOR_INACTIVEBORDER,
+	APPWORKSPACE = COLOR_APPWORKSPACE,
+	HIGHLIGHT = COLOR_HIGHLIGHT,
+	HIGHLIGHTTEXT = COLOR_HIGHLIGHTTEXT,
+	BUTTONFACE = COLOR_BTNFACE,
+	BUTTONSHADOW = COLOR_BTNSHADOW,
+	GRAYTEXT = COLOR_GRAYTEXT,
+	BUTTONTEXT = COLOR_BTNTEXT,
+	INACTIVECAPTIONTEXT = COLOR_INACTIVECAPTIONTEXT,
+	BUTTONHIGHLIGHT = COLOR_BTNHIGHLIGHT,
+	DDARKSHADOW = COLOR_3DDKSHADOW,
+	DLIGHT = COLOR_3DLIGHT,
+	INFOTEXT = COLOR_INFOTEXT,
+	INFOBACKGROUND = COLOR_INFOBK,
+	HOTLIGHT = COLOR_HOTLIGHT,
+	GRADIENTACTIVECAPTION = COLOR_GRADIENTACTIVECAPTION,
+	GRADIENTINACTIVECAPTION = COLOR_GRADIENTINACTIVECAPTION,
+	MENUHIGHLIGHT = COLOR_MENUHILIGHT,
+	MENUBAR = COLOR_MENUBAR,
+
+	// Windows 7 color used for DWM glass composition
+	// See: https://learn.microsoft.com/en-us/windows/win32/api/dwmapi/nf-dwmapi-dwmgetcolorizationcolor
+	WIN7_AERO = 100,
+
+	// Windows 10/11 accent color
+	// Retrieved from uxtheme.dll:GetUserColorPreference
+	ACCENT = 200,
+
+	// Raw DWM values retrived from the undocumented function "DwmGetColorizationParameters"
+	// Note: |WIN8_WINDOW| simulates how Windows 8/8.1 calculates its window color
+	WIN8_WINDOW = 300,
+	DWM_COLORIZATION_COLOR,
+	DWM_AFTERGLOW_COLOR,
+	DWM_COLOR_BALANCE,
+	DWM_AFTERGLOW_BALANCE,
+	DWM_BLUR_BALANCE,
+	DWM_GLASS_REFLECTION_INTENSITY,
+	DWM_OPAQUE_BLEND
+};
+
+// Every ColorType has exactly one slot in the registry (and in the snapshot). The slots are ordered
+// by ColorType value, so the index of a ColorType never changes between sessions.
+constexpr int COLORTYPE_COUNT = 40;
+
+struct ColorTypeInfo
+{
+	LPCWSTR name;		// Name used with the "ColorType" option
+	ColorType type;
+};
+
+extern const ColorTypeInfo c_ColorTypes[COLORTYPE_COUNT];
+
+int GetColorTypeIndex(ColorType type);
+ColorType GetColorTypeFromName(LPCWSTR name);
+LPCWSTR GetColorTypeName(ColorType type);
+
+// Returns the ColorType to use on this system (|ACCENT| falls back to |WIN7_AERO| when not available)
+ColorType ResolveColorType(ColorType type);
+
+// The DWM balance/intensity/blend values are plain numbers, not colors
+inline bool IsNumericColorType(ColorType type) { return type >= ColorType::DWM_COLOR_BALANCE; }
+
+// System colors (GetSysColorBrush) have no alpha channel
+inline bool HasAlpha(ColorType type) { return type >= ColorType::WIN7_AERO; }
+
+// Last value retrieved for each ColorType. Colors are packed in 0xAABBGGRR format, numeric
+// ColorTypes store their value as-is. |generation| is the snapshot generation at which the value
+// last changed (0 if the ColorType was never retrieved).
+struct SnapshotEntry
+{
+	COLORREF value;
+	bool isValid;
+	UINT generation;
+};
+
+struct Snapshot
+{
+	SnapshotEntry entries[COLORTYPE_COUNT];
+	std::atomic<UINT> generation;		// Incremented every time any entry changes
+};
+
+extern Snapshot g_Snapshot;
+
+// Retrieves |type| and stores it in the snapshot. Bumps the generation (and records the change in
+// the history) only when the value actually changed.
+const SnapshotEntry& RefreshColor(ColorType type);
+
+// Colors without an alpha channel are unpacked as opaque
+inline ColorF UnpackColor(ColorType type, COLORREF value)
+{
+	const float a = HasAlpha(type) ? (float)GetAValue(value) : 255.0f;
+	return { (float)GetRValue(value), (float)GetGValue(value), (float)GetBValue(value), a };
+}
+
+inline COLORREF PackColor(const ColorF& color)
+{
+	return RGBA(
+		(int)lroundf(Clamp(color.r, 0.0f, 255.0f)),
+		(int)lroundf(Clamp(color.g, 0.0f, 255.0f)),
+		(int)lroundf(Clamp(color.b, 0.0f, 255.0f)),
+		(int)lroundf(Clamp(color.a, 0.0f, 255.0f)));
+}
+
+std::wstring FormatPackedValue(ColorType type, bool isValid, COLORREF value);
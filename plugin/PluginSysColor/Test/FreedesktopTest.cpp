@@ -0,0 +1,225 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+// Tests the freedesktop theme parsers against the files in Fixtures, and the theme watcher against
+// a temporary copy of them. Linux only, see Makefile.
+
+#include "../Freedesktop.h"
+#include "Test.h"
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+
+#define CHECK_COLOR(theme, color, expected) CheckColor((theme), ThemeColor::color, (expected), #color, __LINE__)
+
+void CheckColor(const FreedesktopTheme& theme, ThemeColor color, uint32_t expected, const char* name, int line)
+{
+	const uint32_t actual = theme.Get(color);
+	if (actual == expected) return;
+
+	fprintf(stderr, "%s(%d): %s is %08X, expected %08X\n", __FILE__, line, name, actual, expected);
+	++g_Failures;
+}
+
+// 0xAABBGGRR, as stored by FreedesktopTheme
+constexpr uint32_t Rgba(uint32_t r, uint32_t g, uint32_t b, uint32_t a = 255U)
+{
+	return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+void Parse(const char* path, void (*parse)(FILE*, FreedesktopTheme&), FreedesktopTheme& theme)
+{
+	theme.Clear();
+
+	const std::string fullPath = std::string(c_Fixtures) + '/' + path;
+	FILE* file = fopen(fullPath.c_str(), "rb");
+	CHECK(file != nullptr);
+	if (!file) return;
+
+	parse(file, theme);
+	fclose(file);
+}
+
+void ParseString(const char* str, void (*parse)(FILE*, FreedesktopTheme&), FreedesktopTheme& theme)
+{
+	theme.Clear();
+
+	FILE* file = tmpfile();
+	fputs(str, file);
+	rewind(file);
+	parse(file, theme);
+	fclose(file);
+}
+
+void TestKdeGlobals()
+{
+	FreedesktopTheme theme;
+	Parse("kdeglobals", ParseKdeGlobals, theme);
+
+	CHECK(theme.mode == ThemeMode::DARK);
+	CHECK_COLOR(theme, WINDOW, Rgba(32, 35, 38));
+	CHECK_COLOR(theme, WINDOW_TEXT, Rgba(252, 252, 252));
+	CHECK_COLOR(theme, VIEW, Rgba(27, 30, 32));
+	CHECK_COLOR(theme, SELECTION, Rgba(61, 174, 233));
+	CHECK_COLOR(theme, BUTTON, Rgba(49, 54, 59));
+	CHECK_COLOR(theme, TOOLTIP, Rgba(49, 54, 59));
+	CHECK_COLOR(theme, LINK, Rgba(29, 153, 243));
+	CHECK_COLOR(theme, DISABLED_TEXT, Rgba(161, 169, 177));
+	CHECK_COLOR(theme, TITLEBAR_INACTIVE, Rgba(35, 38, 41, 128));
+
+	// No AccentColor, so the focus decoration is the accent
+	CHECK_COLOR(theme, ACCENT, Rgba(61, 174, 233));
+
+	// [WM] comes after [Colors:Header]
+	CHECK_COLOR(theme, TITLEBAR, Rgba(49, 54, 59));
+
+	// Not set, falls back to DISABLED_TEXT
+	CHECK(!theme.IsSet(ThemeColor::TITLEBAR_INACTIVE_TEXT));
+	CHECK_COLOR(theme, TITLEBAR_INACTIVE_TEXT, Rgba(161, 169, 177));
+
+	ParseString("[General]\r\nAccentColor=#3daee9\r\nColorScheme=BreezeLight\r\n[Colors:View]\r\nDecorationFocus=1,2,3\r\n",
+		ParseKdeGlobals, theme);
+	CHECK(theme.mode == ThemeMode::LIGHT);
+	CHECK_COLOR(theme, ACCENT, Rgba(0x3D, 0xAE, 0xE9));
+}
+
+void TestGtkSettings()
+{
+	FreedesktopTheme theme;
+	Parse("gtk-3.0/settings.ini", ParseGtkSettings, theme);
+	CHECK(theme.mode == ThemeMode::DARK);
+	CHECK(theme.validMask == 0U);
+
+	ParseString("[Settings]\ngtk-theme-name=Adwaita-dark\n", ParseGtkSettings, theme);
+	CHECK(theme.mode == ThemeMode::DARK);
+
+	ParseString("[Settings]\ngtk-theme-name=Adwaita\ngtk-application-prefer-dark-theme=false\n", ParseGtkSettings, theme);
+	CHECK(theme.mode == ThemeMode::LIGHT);
+
+	// Only [Settings] is read
+	ParseString("[Other]\ngtk-application-prefer-dark-theme=1\n", ParseGtkSettings, theme);
+	CHECK(theme.mode == ThemeMode::UNKNOWN);
+}
+
+void TestGtkCss()
+{
+	FreedesktopTheme theme;
+	Parse("gtk-3.0/gtk.css", ParseGtkCss, theme);
+
+	CHECK(theme.mode == ThemeMode::UNKNOWN);
+	CHECK_COLOR(theme, ACCENT, Rgba(0xE6, 0x61, 0x00));
+	CHECK_COLOR(theme, SELECTION_TEXT, Rgba(255, 255, 255));
+	CHECK_COLOR(theme, WINDOW, Rgba(36, 31, 49));
+	CHECK_COLOR(theme, VIEW, Rgba(36, 31, 49));
+	CHECK_COLOR(theme, TITLEBAR, Rgba(36, 31, 49, 128));
+
+	// Not set, falls back to ACCENT
+	CHECK(!theme.IsSet(ThemeColor::LINK));
+	CHECK_COLOR(theme, LINK, Rgba(0xE6, 0x61, 0x00));
+
+	ParseString("@define-color window_fg_color rgb(100%, 50%, 0%);\n@define-color link_color #0f08;\n", ParseGtkCss, theme);
+	CHECK_COLOR(theme, WINDOW_TEXT, Rgba(255, 128, 0));
+	CHECK_COLOR(theme, LINK, Rgba(0, 255, 0, 0x88));
+}
+
+void TestLoad()
+{
+	FreedesktopTheme theme;
+	CHECK(LoadFreedesktopTheme(c_Fixtures, theme) == 3);
+
+	// gtk.css is read last
+	CHECK(theme.mode == ThemeMode::DARK);
+	CHECK_COLOR(theme, ACCENT, Rgba(0xE6, 0x61, 0x00));
+	CHECK_COLOR(theme, WINDOW, Rgba(36, 31, 49));
+	CHECK_COLOR(theme, BUTTON, Rgba(49, 54, 59));
+	CHECK_COLOR(theme, TITLEBAR, Rgba(36, 31, 49, 128));
+
+	// Default Adwaita colors
+	CHECK(LoadFreedesktopTheme("/nonexistent", theme) == 0);
+	CHECK_COLOR(theme, WINDOW, Rgba(0xFA, 0xFA, 0xFA));
+	theme.mode = ThemeMode::DARK;
+	CHECK_COLOR(theme, WINDOW, Rgba(0x24, 0x24, 0x24));
+}
+
+bool CopyFile(const char* from, const std::string& to)
+{
+	FILE* in = fopen((std::string(c_Fixtures) + '/' + from).c_str(), "rb");
+	FILE* out = fopen(to.c_str(), "wb");
+
+	char buffer[4096];
+	size_t size = 0;
+	while (in && out && (size = fread(buffer, 1, sizeof(buffer), in)) > 0)
+	{
+		fwrite(buffer, 1, size, out);
+	}
+
+	const bool result = in && out;
+	if (in) fclose(in);
+	if (out) fclose(out);
+	return result;
+}
+
+void TestWatcher()
+{
+	char dir[] = "/tmp/SysColorTest.XXXXXX";
+	CHECK(mkdtemp(dir) != nullptr);
+
+	const std::string configDir = dir;
+	CHECK(CopyFile("kdeglobals", configDir + "/kdeglobals"));
+
+	ThemeWatcher watcher;
+	CHECK(watcher.Start(configDir));
+	CHECK(!watcher.HasChanged());
+
+	// Other files are ignored
+	CHECK(CopyFile("kdeglobals", configDir + "/kdeglobals.bak"));
+	CHECK(!watcher.HasChanged());
+
+	// Files are usually replaced, not written
+	CHECK(rename((configDir + "/kdeglobals.bak").c_str(), (configDir + "/kdeglobals").c_str()) == 0);
+	CHECK(watcher.HasChanged());
+	CHECK(!watcher.HasChanged());
+
+	// gtk-3.0 did not exist when the watcher started
+	CHECK(mkdir((configDir + "/gtk-3.0").c_str(), 0700) == 0);
+	CHECK(watcher.HasChanged());
+	CHECK(CopyFile("gtk-3.0/gtk.css", configDir + "/gtk-3.0/gtk.css"));
+	CHECK(watcher.HasChanged());
+
+	FreedesktopTheme theme;
+	CHECK(LoadFreedesktopTheme(configDir, theme) == 2);
+	CHECK_COLOR(theme, ACCENT, Rgba(0xE6, 0x61, 0x00));
+
+	CHECK(unlink((configDir + "/gtk-3.0/gtk.css").c_str()) == 0);
+	CHECK(watcher.HasChanged());
+
+	CHECK(rmdir((configDir + "/gtk-3.0").c_str()) == 0);
+	CHECK(watcher.HasChanged());
+
+	watcher.Stop();
+	CHECK(unlink((configDir + "/kdeglobals").c_str()) == 0);
+	CHECK(!watcher.HasChanged());
+
+	rmdir(dir);
+}
+
+};  // namespace
+
+int main()
+{
+	TestKdeGlobals();
+	TestGtkSettings();
+	TestGtkCss();
+	TestLoad();
+	TestWatcher();
+
+	return GetTestResult("FreedesktopTest");
+}
@@ -0,0 +1,186 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+// Reads and replays Fixtures/Session.log. It was recorded with the Record command while a
+// ColorType=Window and a ColorType=Aero measure were updated in the order Window, Aero, Aero, Window.
+// COLOR_WINDOW was white for the first update of Window and 32,35,38 for the second.
+
+#include "../ProviderLog.h"
+#include "Test.h"
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+constexpr uint32_t COLOR_WINDOW = 5U;
+
+void TestSession()
+{
+	const std::string path = std::string(c_Fixtures) + "/Session.log";
+	FILE* file = fopen(path.c_str(), "rb");
+	CHECK(file != nullptr);
+	if (!file) return;
+
+	CHECK(ReadProviderLogHeader(file));
+
+	ProviderLogRecord record = { };
+	CHECK(ReadProviderLogRecord(file, record));
+	CHECK(record.call == ProviderCall::SYS_COLOR);
+	CHECK(record.argument == COLOR_WINDOW);
+	CHECK(record.result == 0);
+	CHECK(record.data[0] == 0x00FFFFFFU);
+
+	for (int i = 0; i < 2; ++i)
+	{
+		CHECK(ReadProviderLogRecord(file, record));
+		CHECK(record.call == ProviderCall::COLORIZATION_COLOR);
+		CHECK(record.result == 0);
+		CHECK(record.data[0] == 0xC0112233U);	// 0xAARRGGBB
+		CHECK(record.data[1] == 0U);			// Not opaque
+	}
+
+	CHECK(ReadProviderLogRecord(file, record));
+	CHECK(record.call == ProviderCall::SYS_COLOR);
+	CHECK(record.argument == COLOR_WINDOW);
+	CHECK(record.data[0] == 0x00262320U);
+
+	CHECK(!ReadProviderLogRecord(file, record));
+	fclose(file);
+}
+
+std::vector<ProviderLogRecord> ReadSession()
+{
+	std::vector<ProviderLogRecord> records;
+
+	const std::string path = std::string(c_Fixtures) + "/Session.log";
+	FILE* file = fopen(path.c_str(), "rb");
+	CHECK(file != nullptr);
+	if (!file) return records;
+
+	CHECK(ReadProviderLogHeader(file));
+
+	ProviderLogRecord record = { };
+	while (ReadProviderLogRecord(file, record))
+	{
+		records.push_back(record);
+	}
+
+	fclose(file);
+	return records;
+}
+
+void TestReplay()
+{
+	const std::vector<ProviderLogRecord> records = ReadSession();
+	CHECK(records.size() == 4U);
+	if (records.size() != 4U) return;
+
+	ProviderLogCursor cursor;
+	cursor.Reset(records.data(), records.size());
+
+	// Same calls as recorded
+	CHECK(cursor.Next(ProviderCall::SYS_COLOR, COLOR_WINDOW) == &records[0]);
+	CHECK(cursor.Next(ProviderCall::COLORIZATION_COLOR, 0U) == &records[1]);
+	CHECK(cursor.Next(ProviderCall::COLORIZATION_COLOR, 0U) == &records[2]);
+	CHECK(cursor.Next(ProviderCall::SYS_COLOR, COLOR_WINDOW) == &records[3]);
+	CHECK(cursor.GetMismatches() == 0U);
+
+	// Loops at the end
+	CHECK(cursor.GetPosition() == 0U);
+	CHECK(cursor.Next(ProviderCall::SYS_COLOR, COLOR_WINDOW) == &records[0]);
+	CHECK(cursor.GetMismatches() == 0U);
+
+	// Skips the two Aero records
+	CHECK(cursor.Next(ProviderCall::SYS_COLOR, COLOR_WINDOW) == &records[3]);
+	CHECK(cursor.GetMismatches() == 1U);
+
+	// Wraps around to find the next Aero record
+	CHECK(cursor.GetPosition() == 0U);
+	CHECK(cursor.Next(ProviderCall::COLORIZATION_COLOR, 0U) == &records[1]);
+	CHECK(cursor.GetMismatches() == 2U);
+	CHECK(cursor.GetPosition() == 2U);
+
+	// Not recorded: counted, and the position is where it was
+	CHECK(cursor.Next(ProviderCall::SYS_COLOR, 13U) == nullptr);
+	CHECK(cursor.Next(ProviderCall::COMPOSITION_ENABLED, 0U) == nullptr);
+	CHECK(cursor.GetMismatches() == 4U);
+	CHECK(cursor.GetPosition() == 2U);
+
+	// Reset starts over
+	cursor.Reset(records.data(), records.size());
+	CHECK(cursor.GetMismatches() == 0U && cursor.GetPosition() == 0U);
+
+	cursor.Reset(nullptr, 0);
+	CHECK(cursor.Next(ProviderCall::SYS_COLOR, COLOR_WINDOW) == nullptr);
+	CHECK(cursor.GetMismatches() == 1U);
+}
+
+// Replays the session as recorded. Only prints the time, nothing is checked.
+void BenchmarkReplay()
+{
+	const std::vector<ProviderLogRecord> records = ReadSession();
+	if (records.empty()) return;
+
+	ProviderLogCursor cursor;
+	cursor.Reset(records.data(), records.size());
+
+	constexpr int CALLS = 4000000;
+	uint32_t sum = 0U;
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < CALLS; i += 4)
+	{
+		sum += cursor.Next(ProviderCall::SYS_COLOR, COLOR_WINDOW)->data[0];
+		sum += cursor.Next(ProviderCall::COLORIZATION_COLOR, 0U)->data[0];
+		sum += cursor.Next(ProviderCall::COLORIZATION_COLOR, 0U)->data[0];
+		sum += cursor.Next(ProviderCall::SYS_COLOR, COLOR_WINDOW)->data[0];
+	}
+	const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+	CHECK(cursor.GetMismatches() == 0U);
+	printf("Replay: %.1f ns/call (%08X)\n", elapsed.count() / CALLS, sum);
+}
+
+void TestInvalid()
+{
+	// Wrong version
+	FILE* file = tmpfile();
+	const ProviderLogHeader header = { PROVIDERLOG_MAGIC, PROVIDERLOG_VERSION + 1U, (uint32_t)sizeof(ProviderLogRecord), 0U };
+	fwrite(&header, sizeof(header), 1, file);
+	rewind(file);
+	CHECK(!ReadProviderLogHeader(file));
+	fclose(file);
+
+	// Record cut off at the end
+	file = tmpfile();
+	const ProviderLogHeader validHeader = { PROVIDERLOG_MAGIC, PROVIDERLOG_VERSION, (uint32_t)sizeof(ProviderLogRecord), 0U };
+	const ProviderLogRecord record = { ProviderCall::COMPOSITION_ENABLED, 0U, (int32_t)0x80004005, { 0U } };
+	fwrite(&validHeader, sizeof(validHeader), 1, file);
+	fwrite(&record, sizeof(record), 1, file);
+	fwrite(&record, sizeof(record) / 2, 1, file);
+	rewind(file);
+
+	ProviderLogRecord read = { };
+	CHECK(ReadProviderLogHeader(file));
+	CHECK(ReadProviderLogRecord(file, read));
+	CHECK(read.call == ProviderCall::COMPOSITION_ENABLED && read.result < 0);
+	CHECK(!ReadProviderLogRecord(file, read));
+	fclose(file);
+}
+
+};  // namespace
+
+int main()
+{
+	TestSession();
+	TestReplay();
+	TestInvalid();
+	BenchmarkReplay();
+
+	return GetTestResult("ProviderLogTest");
+}
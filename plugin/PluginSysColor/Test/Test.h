@@ -0,0 +1,40 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+// Checks shared by the tests. A failed check is printed and counted, and the test goes on.
+
+#include <stdio.h>
+
+#define CHECK(expr) Check((expr), #expr, __FILE__, __LINE__)
+
+// Files used by the tests, relative to the Test directory
+constexpr const char* c_Fixtures = "Fixtures";
+
+inline int g_Failures = 0;
+
+inline void Check(bool result, const char* expr, const char* file, int line)
+{
+	if (result) return;
+
+	fprintf(stderr, "%s(%d): CHECK(%s) failed\n", file, line, expr);
+	++g_Failures;
+}
+
+// Return value of main
+inline int GetTestResult(const char* name)
+{
+	if (g_Failures > 0)
+	{
+		fprintf(stderr, "%s: %d check(s) failed\n", name, g_Failures);
+		return 1;
+	}
+
+	printf("%s: All tests passed\n", name);
+	return 0;
+}
@@ -0,0 +1,270 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#include "Transform.h"
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <wctype.h>
+
+namespace
+{
+
+struct NamedMatrix
+{
+	LPCWSTR name;
+	float m[3][3];
+};
+
+// Color vision deficiency simulation matrices (severity 1.0) for linear RGB.
+// See: Machado, Oliveira and Fernandes, "A Physiologically-based Model for Simulation of Color
+// Vision Deficiency" (2009)
+const NamedMatrix c_NamedMatrices[] =
+{
+	{ L"Protanopia", {
+		{ 0.152286f, 1.052583f, -0.204868f },
+		{ 0.114503f, 0.786281f, 0.099216f },
+		{ -0.003882f, -0.048116f, 1.051998f } } },
+	{ L"Deuteranopia", {
+		{ 0.367322f, 0.860646f, -0.227968f },
+		{ 0.280085f, 0.672501f, 0.047413f },
+		{ -0.011820f, 0.042940f, 0.968881f } } },
+	{ L"Tritanopia", {
+		{ 1.255528f, -0.076749f, -0.178779f },
+		{ -0.078411f, 0.930809f, 0.147602f },
+		{ 0.004733f, 0.691367f, 0.303900f } } },
+	{ L"Grayscale", {
+		{ 0.2126f, 0.7152f, 0.0722f },
+		{ 0.2126f, 0.7152f, 0.0722f },
+		{ 0.2126f, 0.7152f, 0.0722f } } }
+};
+
+// Colors are transformed in blocks. Channels are kept in separate arrays so that the matrix
+// loop has no dependencies between iterations and can be vectorized by the compiler.
+constexpr int BLOCK_SIZE = 64;
+
+struct Channels
+{
+	float r[BLOCK_SIZE];
+	float g[BLOCK_SIZE];
+	float b[BLOCK_SIZE];
+	float a[BLOCK_SIZE];
+};
+
+void Multiply(const ColorMatrix& matrix, int count, Channels& c)
+{
+	// The coefficients are copied to locals: read through |matrix|, they could alias |c| and would
+	// be loaded again on every iteration, which keeps the compiler from vectorizing the loop.
+	const float m00 = matrix.m[0][0], m01 = matrix.m[0][1], m02 = matrix.m[0][2], m03 = matrix.m[0][3], m04 = matrix.m[0][4];
+	const float m10 = matrix.m[1][0], m11 = matrix.m[1][1], m12 = matrix.m[1][2], m13 = matrix.m[1][3], m14 = matrix.m[1][4];
+	const float m20 = matrix.m[2][0], m21 = matrix.m[2][1], m22 = matrix.m[2][2], m23 = matrix.m[2][3], m24 = matrix.m[2][4];
+	const float m30 = matrix.m[3][0], m31 = matrix.m[3][1], m32 = matrix.m[3][2], m33 = matrix.m[3][3], m34 = matrix.m[3][4];
+
+	for (int i = 0; i < count; ++i)
+	{
+		const float r = c.r[i];
+		const float g = c.g[i];
+		const float b = c.b[i];
+		const float a = c.a[i];
+		c.r[i] = m00 * r + m01 * g + m02 * b + m03 * a + m04;
+		c.g[i] = m10 * r + m11 * g + m12 * b + m13 * a + m14;
+		c.b[i] = m20 * r + m21 * g + m22 * b + m23 * a + m24;
+		c.a[i] = m30 * r + m31 * g + m32 * b + m33 * a + m34;
+	}
+}
+
+// Snapshot channels are bytes, so the sRGB to linear conversion is a table lookup
+const float* GetLinearTable()
+{
+	static float s_Table[256] = { -1.0f };
+	if (s_Table[0] < 0.0f)
+	{
+		for (int i = 0; i < 256; ++i)
+		{
+			s_Table[i] = SrgbToLinear((float)i);
+		}
+	}
+
+	return s_Table;
+}
+
+BYTE ToByte(float value)
+{
+	return (BYTE)lroundf(Clamp(value, 0.0f, 255.0f));
+}
+
+std::vector<std::weak_ptr<SnapshotTransform>> g_Transforms;
+
+};  // namespace
+
+bool ParseColorMatrix(LPCWSTR str, ColorMatrix& matrix, std::wstring& error)
+{
+	memset(&matrix, 0, sizeof(matrix));
+	matrix.m[3][3] = 1.0f;
+
+	for (const auto& named : c_NamedMatrices)
+	{
+		if (_wcsicmp(named.name, str) != 0) continue;
+
+		for (int row = 0; row < 3; ++row)
+		{
+			for (int col = 0; col < 3; ++col)
+			{
+				matrix.m[row][col] = named.m[row][col];
+			}
+		}
+		return true;
+	}
+
+	std::vector<float> numbers;
+	for (LPCWSTR pos = str; *pos; )
+	{
+		WCHAR* end = nullptr;
+		const double number = wcstod(pos, &end);
+		while (end != pos && iswspace(*end)) ++end;
+		if (end == pos || (*end != L';' && *end != L'\0'))
+		{
+			error = L"Invalid number in: ";
+			error += str;
+			return false;
+		}
+
+		numbers.push_back((float)number);
+		pos = (*end == L';') ? end + 1 : end;
+	}
+
+	if (numbers.size() == 9)
+	{
+		for (int i = 0; i < 9; ++i)
+		{
+			matrix.m[i / 3][i % 3] = numbers[i];
+		}
+		return true;
+	}
+	else if (numbers.size() == 20)
+	{
+		for (int i = 0; i < 20; ++i)
+		{
+			matrix.m[i / 5][i % 5] = numbers[i];
+		}
+		return true;
+	}
+
+	error = L"Expected a name, 9 (3x3) or 20 (4x5) numbers: ";
+	error += str;
+	return false;
+}
+
+SnapshotTransform::SnapshotTransform(const ColorMatrix& matrix) :
+	m_Matrix(matrix),
+	m_Generation(UINT_MAX),
+	m_Values()
+{
+}
+
+COLORREF SnapshotTransform::Get(int index)
+{
+	const UINT generation = g_Snapshot.generation.load();
+	if (generation != m_Generation)
+	{
+		Update();
+		m_Generation = generation;
+	}
+
+	return m_Values[index];
+}
+
+void SnapshotTransform::Update()
+{
+	static_assert(COLORTYPE_COUNT <= BLOCK_SIZE, "Snapshot does not fit in one block");
+
+	const float* linear = GetLinearTable();
+	Channels c;
+
+	// Entries that are not colors are transformed too (as black) and ignored afterwards
+	for (int i = 0; i < COLORTYPE_COUNT; ++i)
+	{
+		const SnapshotEntry& entry = g_Snapshot.entries[i];
+		const ColorType type = c_ColorTypes[i].type;
+		const bool isColor = entry.isValid && !IsNumericColorType(type);
+		const COLORREF value = isColor ? entry.value : 0;
+
+		c.r[i] = linear[GetRValue(value)];
+		c.g[i] = linear[GetGValue(value)];
+		c.b[i] = linear[GetBValue(value)];
+		c.a[i] = HasAlpha(type) ? GetAValue(value) / 255.0f : 1.0f;
+	}
+
+	Multiply(m_Matrix, COLORTYPE_COUNT, c);
+
+	for (int i = 0; i < COLORTYPE_COUNT; ++i)
+	{
+		const SnapshotEntry& entry = g_Snapshot.entries[i];
+		const ColorType type = c_ColorTypes[i].type;
+		if (!entry.isValid || IsNumericColorType(type))
+		{
+			m_Values[i] = entry.value;
+			continue;
+		}
+
+		// System colors have no alpha, so keep it out of the output
+		m_Values[i] = RGBA(
+			ToByte(LinearToSrgb(c.r[i])),
+			ToByte(LinearToSrgb(c.g[i])),
+			ToByte(LinearToSrgb(c.b[i])),
+			HasAlpha(type) ? ToByte(c.a[i] * 255.0f) : 0);
+	}
+}
+
+void SnapshotTransform::Apply(ColorF* colors, int count) const
+{
+	Channels c;
+	for (int begin = 0; begin < count; begin += BLOCK_SIZE)
+	{
+		const int size = (count - begin < BLOCK_SIZE) ? count - begin : BLOCK_SIZE;
+		ColorF* block = colors + begin;
+
+		for (int i = 0; i < size; ++i)
+		{
+			c.r[i] = SrgbToLinear(block[i].r);
+			c.g[i] = SrgbToLinear(block[i].g);
+			c.b[i] = SrgbToLinear(block[i].b);
+			c.a[i] = block[i].a / 255.0f;
+		}
+
+		Multiply(m_Matrix, size, c);
+
+		for (int i = 0; i < size; ++i)
+		{
+			block[i].r = LinearToSrgb(c.r[i]);
+			block[i].g = LinearToSrgb(c.g[i]);
+			block[i].b = LinearToSrgb(c.b[i]);
+			block[i].a = Clamp(c.a[i] * 255.0f, 0.0f, 255.0f);
+		}
+	}
+}
+
+std::shared_ptr<SnapshotTransform> GetSnapshotTransform(const ColorMatrix& matrix)
+{
+	for (auto it = g_Transforms.begin(); it != g_Transforms.end();)
+	{
+		auto transform = it->lock();
+		if (!transform)
+		{
+			// Forget transforms no longer used by any measure
+			it = g_Transforms.erase(it);
+			continue;
+		}
+
+		if (memcmp(&transform->GetMatrix(), &matrix, sizeof(matrix)) == 0) return transform;
+		++it;
+	}
+
+	auto transform = std::make_shared<SnapshotTransform>(matrix);
+	g_Transforms.push_back(transform);
+	return transform;
+}
@@ -0,0 +1,47 @@
+/* Copyright (C) 2022 Brian Ferguson
+ *
+ * This Source Code Form is subject to the terms of the GNU General Public
+ * License; either version 2 of the License, or (at your option) any later
+ * version. If a copy of the GPL was not distributed with this file, You can
+ * obtain one at <https://www.gnu.org/licenses/gpl-2.0.html>. */
+
+#pragma once
+
+#include "SysColor.h"
+#include <memory>
+
+// Rows are the output red, green, blue and alpha. Columns are the input red, green, blue, alpha
+// and a constant offset. Applied to linear RGB (0-1).
+struct ColorMatrix
+{
+	float m[4][5];
+};
+
+// Name (Protanopia, Deuteranopia, Tritanopia, Grayscale) or 9 (3x3) or 20 (4x5) numbers separated by ";"
+bool ParseColorMatrix(LPCWSTR str, ColorMatrix& matrix, std::wstring& error);
+
+// Transformed copy of the whole snapshot. All entries are transformed at once, and only when the
+// snapshot generation changed since the last time.
+class SnapshotTransform
+{
+public:
+	SnapshotTransform(const ColorMatrix& matrix);
+
+	const ColorMatrix& GetMatrix() const { return m_Matrix; }
+
+	// Transformed value of a valid snapshot entry
+	COLORREF Get(int index);
+
+	// Transforms colors that are not part of the snapshot (eg. Derive results)
+	void Apply(ColorF* colors, int count) const;
+
+private:
+	void Update();
+
+	ColorMatrix m_Matrix;
+	UINT m_Generation;
+	COLORREF m_Values[COLORTYPE_COUNT];
+};
+
+// Measures with the same matrix share a transform
+std::shared_ptr<SnapshotTransform> GetSnapshotTransform(const ColorMatrix& matrix);